@@ -0,0 +1,153 @@
+// The display the terminal draws on
+//
+// vt100.cpp and the sketch only use the display_* names below, which map
+// to one driver at compile time:
+//
+//   ili9340.cpp  240x320 ILI9340 (default)
+//   ra8876.cpp   1024x600 RA8876 on the ER-TFTM070-6, when VT100_RA8876
+//                is defined (here or on the compiler command line)
+//
+// DISPLAY_MAX_WIDTH / DISPLAY_MAX_HEIGHT are the largest size in pixels
+// over all rotations. DISPLAY_LAYERS is the number of screens the panel
+// can keep, with two the alternate screen gets its own. DISPLAY_COPY is 1
+// when the panel can move a rectangle by itself. DISPLAY_SCROLL is 1 when
+// it has a vertical scroll window (setScrollMargins() / setScrollStart()),
+// otherwise terminals scroll by moving rows. DISPLAY_CHAR_WIDTH /
+// DISPLAY_CHAR_HEIGHT is the text cell drawChars() draws.
+//
+// The drawing calls and colours go into a display list (dlist.h), unless
+// VT100_DLIST is 0. display_flush() hands the list to the driver, or to
+// the render core with VT100_PIPELINE (drawq.h), and display_sync() also
+// waits until it is on the panel. Without the list both do nothing.
+
+#pragma once
+
+#include <stdint.h>
+
+#include "profile.h"
+#include "dlist.h"
+#include "drawq.h"
+
+//#define VT100_RA8876
+
+// every call that puts something on the panel goes through here. Host
+// builds count them for the benchmark, and with VT100_PROFILE each is
+// timed under its own entry.
+#if defined(VT100_HOST)
+extern uint32_t display_calls;
+#define DISPLAY_COUNT() display_calls++
+#else
+#define DISPLAY_COUNT()
+#endif
+#define DISPLAY_DRAW(id, call) do { \
+	PROFILE_START(_draw_start); \
+	DISPLAY_COUNT(); \
+	call; \
+	PROFILE_END(id, _draw_start); \
+} while(0)
+
+#if defined(VT100_RA8876)
+#include "ra8876.h"
+
+#define DISPLAY_MAX_WIDTH RA8876_WIDTH
+#define DISPLAY_MAX_HEIGHT RA8876_HEIGHT
+#define DISPLAY_LAYERS RA8876_LAYERS
+#define DISPLAY_COPY 1
+#define DISPLAY_SCROLL 0
+#define DISPLAY_CHAR_WIDTH RA8876_CHAR_WIDTH
+#define DISPLAY_CHAR_HEIGHT RA8876_CHAR_HEIGHT
+
+#define display_init ra8876_init
+#define display_setRotation ra8876_setRotation
+#define display_width ra8876_width
+#define display_height ra8876_height
+#define display_setBackColor ra8876_setBackColor
+#define display_setFrontColor ra8876_setFrontColor
+#define display_drawChars(...) DISPLAY_DRAW(PROFILE_DRAW_CHARS, ra8876_drawChars(__VA_ARGS__))
+#define display_drawString(...) DISPLAY_DRAW(PROFILE_DRAW_STRING, ra8876_drawString(__VA_ARGS__))
+#define display_fillRect(...) DISPLAY_DRAW(PROFILE_FILL_RECT, ra8876_fillRect(__VA_ARGS__))
+#define display_drawRect(...) DISPLAY_DRAW(PROFILE_DRAW_RECT, ra8876_drawRect(__VA_ARGS__))
+#define display_drawFastHLine(...) DISPLAY_DRAW(PROFILE_DRAW_HLINE, ra8876_drawFastHLine(__VA_ARGS__))
+#define display_drawFastVLine(...) DISPLAY_DRAW(PROFILE_DRAW_VLINE, ra8876_drawFastVLine(__VA_ARGS__))
+#define display_drawPixel(...) DISPLAY_DRAW(PROFILE_DRAW_PIXEL, ra8876_drawPixel(__VA_ARGS__))
+#define display_drawLine(...) DISPLAY_DRAW(PROFILE_DRAW_LINE, ra8876_drawLine(__VA_ARGS__))
+#define display_setScrollStart(start)
+#define display_setScrollMargins(top, bottom)
+#define display_copyRect(...) DISPLAY_DRAW(PROFILE_COPY_RECT, ra8876_copyRect(__VA_ARGS__))
+#define display_setLayer(...) DISPLAY_DRAW(PROFILE_SET_LAYER, ra8876_setLayer(__VA_ARGS__))
+#else
+#include "ili9340.h"
+
+#define DISPLAY_MAX_WIDTH ILI9340_TFTHEIGHT
+#define DISPLAY_MAX_HEIGHT ILI9340_TFTHEIGHT
+#define DISPLAY_LAYERS 1
+#define DISPLAY_COPY 0
+#define DISPLAY_SCROLL 1
+#define DISPLAY_CHAR_WIDTH 6
+#define DISPLAY_CHAR_HEIGHT 8
+
+#define display_init ili9340_init
+#define display_setRotation ili9340_setRotation
+#define display_width ili9340_width
+#define display_height ili9340_height
+#define display_setBackColor ili9340_setBackColor
+#define display_setFrontColor ili9340_setFrontColor
+#define display_drawChars(...) DISPLAY_DRAW(PROFILE_DRAW_CHARS, ili9340_drawChars(__VA_ARGS__))
+#define display_drawString(...) DISPLAY_DRAW(PROFILE_DRAW_STRING, ili9340_drawString(__VA_ARGS__))
+#define display_fillRect(...) DISPLAY_DRAW(PROFILE_FILL_RECT, ili9340_fillRect(__VA_ARGS__))
+#define display_drawRect(...) DISPLAY_DRAW(PROFILE_DRAW_RECT, ili9340_drawRect(__VA_ARGS__))
+#define display_drawFastHLine(...) DISPLAY_DRAW(PROFILE_DRAW_HLINE, ili9340_drawFastHLine(__VA_ARGS__))
+#define display_drawFastVLine(...) DISPLAY_DRAW(PROFILE_DRAW_VLINE, ili9340_drawFastVLine(__VA_ARGS__))
+#define display_drawPixel(...) DISPLAY_DRAW(PROFILE_DRAW_PIXEL, ili9340_drawPixel(__VA_ARGS__))
+#define display_drawLine(...) DISPLAY_DRAW(PROFILE_DRAW_LINE, ili9340_drawLine(__VA_ARGS__))
+#define display_setScrollStart(...) DISPLAY_DRAW(PROFILE_SCROLL_START, ili9340_setScrollStart(__VA_ARGS__))
+#define display_setScrollMargins(...) DISPLAY_DRAW(PROFILE_SCROLL_MARGINS, ili9340_setScrollMargins(__VA_ARGS__))
+#define display_copyRect(x, y, w, h, dx, dy)
+#define display_setLayer(layer)
+#endif
+
+// dlist.cpp defines DISPLAY_DRIVER to get the driver itself
+#if VT100_DLIST && !defined(DISPLAY_DRIVER)
+#undef display_setBackColor
+#undef display_setFrontColor
+#undef display_drawChars
+#undef display_drawString
+#undef display_fillRect
+#undef display_drawRect
+#undef display_drawFastHLine
+#undef display_drawFastVLine
+#undef display_drawPixel
+#undef display_drawLine
+#undef display_setScrollStart
+#undef display_setScrollMargins
+#define display_setBackColor dlist_setBackColor
+#define display_setFrontColor dlist_setFrontColor
+#define display_drawChars dlist_drawChars
+#define display_drawString dlist_drawString
+#define display_fillRect dlist_fillRect
+#define display_drawRect dlist_drawRect
+#define display_drawFastHLine dlist_drawFastHLine
+#define display_drawFastVLine dlist_drawFastVLine
+#define display_drawPixel dlist_drawPixel
+#define display_drawLine dlist_drawLine
+#define display_setScrollStart dlist_setScrollStart
+#define display_setScrollMargins dlist_setScrollMargins
+#if DISPLAY_COPY
+#undef display_copyRect
+#define display_copyRect dlist_copyRect
+#endif
+#if DISPLAY_LAYERS > 1
+#undef display_setLayer
+#define display_setLayer dlist_setLayer
+#endif
+#define display_flush dlist_flush
+#define display_sync dlist_sync
+#else
+#define display_flush()
+#define display_sync()
+#endif
+
+// RGB565
+#define DISPLAY_BLACK 0x0000
+#define DISPLAY_BLUE 0x001F
+#define DISPLAY_RED 0xF800
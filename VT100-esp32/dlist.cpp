@@ -0,0 +1,316 @@
+// Display list, see dlist.h
+
+#include "dlist.h"
+
+#if VT100_DLIST
+
+#include <arduino.h>
+#include <string.h>
+
+// the real driver calls, for dlist_exec()
+#define DISPLAY_DRIVER
+#include "display.h"
+#include "drawq.h"
+#include "latency.h"
+
+// ops: the code, its 16 bit arguments (dlist_args) low byte first, and
+// for text a count and the characters. Dropped ops stay in the list with
+// DLIST_DEAD set.
+enum {
+	DLIST_COLORS,
+	DLIST_CHARS,
+	DLIST_STRING,
+	DLIST_FILL,
+	DLIST_RECT,
+	DLIST_HLINE,
+	DLIST_VLINE,
+	DLIST_PIXEL,
+	DLIST_LINE,
+	DLIST_SCROLL_START,
+	DLIST_SCROLL_MARGINS,
+	DLIST_COPY,
+	DLIST_LAYER,
+	DLIST_LATENCY
+};
+#define DLIST_DEAD 0x80
+
+static const uint8_t dlist_args[] = { 2, 2, 2, 5, 6, 4, 4, 3, 5, 1, 2, 6, 1, 2 };
+
+// longest text op, so that it fits a list with its colours
+#define DLIST_TEXT_MAX ((DLIST_SIZE - 11 < 255)?DLIST_SIZE - 11:255)
+
+static struct dlist {
+	uint8_t buf[DLIST_SIZE];
+	uint16_t len;
+	uint16_t last; // offset of the newest op
+	uint16_t barrier; // fills look back to here, past it coordinates moved
+	// colours set by the terminal, and the ones last recorded in the list
+	uint16_t front, back;
+	uint16_t list_front, list_back;
+	uint8_t list_colors;
+	uint32_t merged, dropped;
+} dl;
+
+struct dlist_box {
+	int32_t x0, y0, x1, y1;
+};
+
+static inline uint16_t _dlist_arg(const uint8_t *op, uint8_t i){
+	return op[1 + i * 2] | op[2 + i * 2] << 8;
+}
+
+static uint16_t _dlist_size(const uint8_t *op){
+	uint8_t code = op[0] & ~DLIST_DEAD;
+	uint16_t size = 1 + dlist_args[code] * 2;
+	if(code == DLIST_CHARS || code == DLIST_STRING) size += 1 + op[size];
+	return size;
+}
+
+// the area an op paints, 0 for ops that paint nothing or aren't covered
+// by a fill
+static uint8_t _dlist_bounds(const uint8_t *op, struct dlist_box *b){
+	int32_t x = (int16_t)_dlist_arg(op, 0), y = (int16_t)_dlist_arg(op, 1);
+	b->x0 = x;
+	b->y0 = y;
+	switch(op[0]){
+		case DLIST_CHARS:
+			b->x1 = x + op[5] * DISPLAY_CHAR_WIDTH;
+			b->y1 = y + DISPLAY_CHAR_HEIGHT;
+			return 1;
+		case DLIST_FILL:
+		case DLIST_RECT:
+			b->x1 = x + _dlist_arg(op, 2);
+			b->y1 = y + _dlist_arg(op, 3);
+			return 1;
+		case DLIST_HLINE:
+			b->x1 = x + (int16_t)_dlist_arg(op, 2);
+			b->y1 = y + 1;
+			return b->x1 > x;
+		case DLIST_VLINE:
+			b->x1 = x + 1;
+			b->y1 = y + (int16_t)_dlist_arg(op, 2);
+			return b->y1 > y;
+		case DLIST_PIXEL:
+			b->x1 = x + 1;
+			b->y1 = y + 1;
+			return 1;
+		case DLIST_LINE: {
+			int32_t x1 = (int16_t)_dlist_arg(op, 2), y1 = (int16_t)_dlist_arg(op, 3);
+			if(x1 < x) b->x0 = x1;
+			if(y1 < y) b->y0 = y1;
+			b->x1 = ((x1 > x)?x1:x) + 1;
+			b->y1 = ((y1 > y)?y1:y) + 1;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// makes room for size bytes, flushing the list when it is full
+static void _dlist_room(uint16_t size){
+	if(dl.len + size > DLIST_SIZE) dlist_flush();
+}
+
+static uint8_t *_dlist_add(uint8_t code, const uint16_t *args, uint16_t extra){
+	uint16_t size = 1 + dlist_args[code] * 2 + extra;
+	_dlist_room(size);
+	uint8_t *op = &dl.buf[dl.len];
+	op[0] = code;
+	for(uint8_t i = 0; i < dlist_args[code]; i++){
+		op[1 + i * 2] = args[i];
+		op[2 + i * 2] = args[i] >> 8;
+	}
+	dl.last = dl.len;
+	dl.len += size;
+	return op;
+}
+
+// ops after which coordinates or the layer mean something else
+static void _dlist_barrier(uint8_t code, const uint16_t *args){
+	_dlist_add(code, args, 0);
+	dl.barrier = dl.len;
+}
+
+// text is drawn in the driver's current colours, they only go in the
+// list when text needs them
+static void _dlist_colors(void){
+	if(dl.list_colors && dl.list_front == dl.front && dl.list_back == dl.back) return;
+	uint16_t a[] = { dl.front, dl.back };
+	_dlist_add(DLIST_COLORS, a, 0);
+	dl.list_front = dl.front;
+	dl.list_back = dl.back;
+	dl.list_colors = 1;
+}
+
+static void _dlist_text(uint8_t code, uint16_t x, uint16_t y, const uint8_t *text, uint8_t count){
+	// with the colours, so a flush can't come between them
+	_dlist_room(5 + 6 + count);
+	_dlist_colors();
+	uint8_t *op = &dl.buf[dl.last];
+	if(code == DLIST_CHARS && dl.len && op[0] == DLIST_CHARS && _dlist_arg(op, 1) == y &&
+		_dlist_arg(op, 0) + op[5] * DISPLAY_CHAR_WIDTH == x && op[5] + count <= DLIST_TEXT_MAX){
+		// the newest op is a run ending where this one starts
+		memcpy(&dl.buf[dl.len], text, count);
+		op[5] += count;
+		dl.len += count;
+		dl.merged++;
+		return;
+	}
+	uint16_t a[] = { x, y };
+	op = _dlist_add(code, a, 1 + count);
+	op[5] = count;
+	memcpy(&op[6], text, count);
+}
+
+void dlist_setBackColor(uint16_t col){
+	dl.back = col;
+}
+
+void dlist_setFrontColor(uint16_t col){
+	dl.front = col;
+}
+
+void dlist_drawChars(uint16_t x, uint16_t y, const uint8_t *chars, uint8_t count){
+	while(count > DLIST_TEXT_MAX){
+		_dlist_text(DLIST_CHARS, x, y, chars, DLIST_TEXT_MAX);
+		x += DLIST_TEXT_MAX * DISPLAY_CHAR_WIDTH;
+		chars += DLIST_TEXT_MAX;
+		count -= DLIST_TEXT_MAX;
+	}
+	_dlist_text(DLIST_CHARS, x, y, chars, count);
+}
+
+void dlist_drawString(uint16_t x, uint16_t y, const char *text){
+	size_t len = strlen(text);
+	_dlist_text(DLIST_STRING, x, y, (const uint8_t *)text, (len > DLIST_TEXT_MAX)?DLIST_TEXT_MAX:len);
+}
+
+void dlist_fillRect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color){
+	// whatever the fill paints over completely never needs drawing
+	struct dlist_box b;
+	for(uint16_t at = dl.barrier; at < dl.len; at += _dlist_size(&dl.buf[at])){
+		uint8_t *op = &dl.buf[at];
+		if(_dlist_bounds(op, &b) && b.x0 >= x && b.y0 >= y &&
+			b.x1 <= (int32_t)x + w && b.y1 <= (int32_t)y + h){
+			op[0] |= DLIST_DEAD;
+			dl.dropped++;
+		}
+	}
+	uint16_t a[] = { x, y, w, h, color };
+	_dlist_add(DLIST_FILL, a, 0);
+}
+
+void dlist_drawRect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color, uint16_t backColor){
+	uint16_t a[] = { x, y, w, h, color, backColor };
+	_dlist_add(DLIST_RECT, a, 0);
+}
+
+void dlist_drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color){
+	uint16_t a[] = { (uint16_t)x, (uint16_t)y, (uint16_t)w, color };
+	_dlist_add(DLIST_HLINE, a, 0);
+}
+
+void dlist_drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color){
+	uint16_t a[] = { (uint16_t)x, (uint16_t)y, (uint16_t)h, color };
+	_dlist_add(DLIST_VLINE, a, 0);
+}
+
+void dlist_drawPixel(int16_t x, int16_t y, uint16_t color){
+	uint16_t a[] = { (uint16_t)x, (uint16_t)y, color };
+	_dlist_add(DLIST_PIXEL, a, 0);
+}
+
+void dlist_drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color){
+	uint16_t a[] = { (uint16_t)x0, (uint16_t)y0, (uint16_t)x1, (uint16_t)y1, color };
+	_dlist_add(DLIST_LINE, a, 0);
+}
+
+void dlist_setScrollStart(uint16_t start){
+	// nothing drawn since the last one, it is overtaken
+	if(dl.len && dl.buf[dl.last] == DLIST_SCROLL_START){
+		dl.buf[dl.last + 1] = start;
+		dl.buf[dl.last + 2] = start >> 8;
+		dl.dropped++;
+		return;
+	}
+	_dlist_barrier(DLIST_SCROLL_START, &start);
+}
+
+void dlist_setScrollMargins(uint16_t top, uint16_t bottom){
+	uint16_t a[] = { top, bottom };
+	_dlist_barrier(DLIST_SCROLL_MARGINS, a);
+}
+
+void dlist_copyRect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t dx, uint16_t dy){
+	uint16_t a[] = { x, y, w, h, dx, dy };
+	_dlist_barrier(DLIST_COPY, a);
+}
+
+void dlist_setLayer(uint8_t layer){
+	uint16_t a = layer;
+	_dlist_barrier(DLIST_LAYER, &a);
+}
+
+void dlist_latency(uint32_t arrived){
+	uint16_t a[] = { (uint16_t)arrived, (uint16_t)(arrived >> 16) };
+	_dlist_add(DLIST_LATENCY, a, 0);
+}
+
+void dlist_flush(void){
+	if(!dl.len) return;
+#if VT100_PIPELINE
+	drawq_write(dl.buf, dl.len);
+#else
+	dlist_exec(dl.buf, dl.len);
+#endif
+	dl.len = 0;
+	dl.barrier = 0;
+	dl.list_colors = 0;
+}
+
+void dlist_sync(void){
+	dlist_flush();
+#if VT100_PIPELINE
+	drawq_sync();
+#endif
+}
+
+void dlist_exec(const uint8_t *list, uint16_t len){
+	for(uint16_t at = 0; at < len; at += _dlist_size(&list[at])){
+		const uint8_t *op = &list[at];
+		uint16_t a[6];
+		for(uint8_t i = 0; i < dlist_args[op[0] & ~DLIST_DEAD]; i++) a[i] = _dlist_arg(op, i);
+		switch(op[0]){
+			case DLIST_COLORS:
+				display_setFrontColor(a[0]);
+				display_setBackColor(a[1]);
+				break;
+			case DLIST_CHARS: display_drawChars(a[0], a[1], &op[6], op[5]); break;
+			case DLIST_STRING: {
+				char text[256];
+				memcpy(text, &op[6], op[5]);
+				text[op[5]] = 0;
+				display_drawString(a[0], a[1], text);
+				break;
+			}
+			case DLIST_FILL: display_fillRect(a[0], a[1], a[2], a[3], a[4]); break;
+			case DLIST_RECT: display_drawRect(a[0], a[1], a[2], a[3], a[4], a[5]); break;
+			case DLIST_HLINE: display_drawFastHLine((int16_t)a[0], (int16_t)a[1], (int16_t)a[2], a[3]); break;
+			case DLIST_VLINE: display_drawFastVLine((int16_t)a[0], (int16_t)a[1], (int16_t)a[2], a[3]); break;
+			case DLIST_PIXEL: display_drawPixel((int16_t)a[0], (int16_t)a[1], a[2]); break;
+			case DLIST_LINE: display_drawLine((int16_t)a[0], (int16_t)a[1], (int16_t)a[2], (int16_t)a[3], a[4]); break;
+			case DLIST_SCROLL_START: display_setScrollStart(a[0]); break;
+			case DLIST_SCROLL_MARGINS: display_setScrollMargins(a[0], a[1]); break;
+			case DLIST_COPY: display_copyRect(a[0], a[1], a[2], a[3], a[4], a[5]); break;
+			case DLIST_LAYER: display_setLayer(a[0]); break;
+			case DLIST_LATENCY: latency_add(micros() - (a[0] | (uint32_t)a[1] << 16)); break;
+		}
+	}
+}
+
+void dlist_stats(uint32_t *merged, uint32_t *dropped){
+	*merged = dl.merged;
+	*dropped = dl.dropped;
+}
+
+#endif
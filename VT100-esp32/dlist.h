@@ -0,0 +1,70 @@
+// Display list between the terminal and the display driver
+//
+// The drawing calls in display.h don't go to the driver straight away.
+// They are appended to a display list, a packed stream of draw ops (glyph
+// run, fill, rectangle, lines, scroll, colours) that is handed to the
+// driver in one go by dlist_flush(), once per frame (vt100_flush()). With
+// VT100_PIPELINE the whole list goes to the render core instead
+// (drawq.h), which executes it there.
+//
+// While ops wait in the list they are cheap to improve on:
+//
+//   - colours are only recorded when text is drawn with them, so a row of
+//     runs in the same colours sets them once
+//   - a glyph run that continues the previous one on the same line, in
+//     the same colours, is merged into it
+//   - anything a later fill covers completely is dropped, up to the last
+//     scroll, copy or layer switch (those move what coordinates mean)
+//   - of several scroll start updates in a row only the last is kept
+//
+// dlist_stats() counts the glyph runs merged and the ops dropped.
+//
+// Set VT100_DLIST to 0 to draw directly, without the list.
+
+#pragma once
+
+#include <stdint.h>
+
+#ifndef VT100_DLIST
+#define VT100_DLIST 1
+#endif
+
+// bytes of ops kept before the list is flushed early
+#ifndef DLIST_SIZE
+#if defined(__AVR__) && !defined(VT100_HOST)
+#define DLIST_SIZE 256
+#else
+#define DLIST_SIZE 2048
+#endif
+#endif
+
+#if VT100_DLIST
+
+// the display.h drawing calls, appended to the list
+void dlist_setBackColor(uint16_t col);
+void dlist_setFrontColor(uint16_t col);
+void dlist_drawChars(uint16_t x, uint16_t y, const uint8_t *chars, uint8_t count);
+void dlist_drawString(uint16_t x, uint16_t y, const char *text);
+void dlist_fillRect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color);
+void dlist_drawRect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color, uint16_t backColor);
+void dlist_drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+void dlist_drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+void dlist_drawPixel(int16_t x, int16_t y, uint16_t color);
+void dlist_drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color);
+void dlist_setScrollStart(uint16_t start);
+void dlist_setScrollMargins(uint16_t top, uint16_t bottom);
+void dlist_copyRect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t dx, uint16_t dy);
+void dlist_setLayer(uint8_t layer);
+// closes a latency sample (latency.h) when the list is executed, that
+// is when what was drawn before it is on the panel
+void dlist_latency(uint32_t arrived);
+
+// hands the list to the driver (or the render core) and starts a new one
+void dlist_flush(void);
+// flushes and waits until the panel shows everything
+void dlist_sync(void);
+// executes a list on the driver, on the render core for the pipeline
+void dlist_exec(const uint8_t *list, uint16_t len);
+void dlist_stats(uint32_t *merged, uint32_t *dropped);
+
+#endif
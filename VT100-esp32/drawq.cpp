@@ -0,0 +1,148 @@
+// Draw queue between the parser and the renderer, see drawq.h
+
+#include "drawq.h"
+
+#if VT100_PIPELINE
+
+#include "dlist.h"
+
+#if defined(VT100_HOST)
+#include <pthread.h>
+#include <sched.h>
+#else
+#include <Arduino.h>
+#endif
+
+#if !VT100_DLIST
+#error "VT100_PIPELINE sends display lists, it needs VT100_DLIST"
+#endif
+#if DRAWQ_SIZE < DLIST_SIZE + 2
+#error "DRAWQ_SIZE must hold a display list"
+#endif
+
+#define DRAWQ_MASK (DRAWQ_SIZE - 1)
+
+// the ring holds display lists, each behind its length (low byte first)
+static struct drawq {
+	uint8_t buf[DRAWQ_SIZE];
+	// free running positions, head is written by the parser only and
+	// tail by the renderer only
+	uint32_t head, tail;
+	// parser side: end of what it has written
+	uint32_t pos;
+	uint32_t stalls;
+	uint16_t high_water;
+	// renderer side: start of the next list, and the list being drawn
+	uint32_t next;
+	uint8_t list[DLIST_SIZE];
+	// the renderer is about to sleep and wants a notification
+	uint8_t sleeping;
+#if !defined(VT100_HOST)
+	TaskHandle_t task;
+#endif
+} q;
+
+// parser side waiting for room, or for the renderer to finish
+static void _drawq_wait(void){
+#if defined(VT100_HOST)
+	sched_yield();
+#else
+	// plenty of time for the renderer to free a few lists
+	vTaskDelay(1);
+#endif
+}
+
+static void _drawq_wake(void){
+#if !defined(VT100_HOST)
+	if(__atomic_load_n(&q.sleeping, __ATOMIC_SEQ_CST)) xTaskNotifyGive(q.task);
+#endif
+}
+
+// renderer side, nothing queued
+static void _drawq_idle(void){
+#if defined(VT100_HOST)
+	sched_yield();
+#else
+	// the parser sees the flag after its head store or this sees the new
+	// head, so a wakeup is never lost. The tick is only a safety net.
+	__atomic_store_n(&q.sleeping, 1, __ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&q.head, __ATOMIC_SEQ_CST) == q.next) ulTaskNotifyTake(pdTRUE, 1);
+	__atomic_store_n(&q.sleeping, 0, __ATOMIC_RELAXED);
+#endif
+}
+
+void drawq_write(const uint8_t *list, uint16_t len){
+	uint16_t size = 2 + len;
+	uint32_t used = q.pos - __atomic_load_n(&q.tail, __ATOMIC_ACQUIRE);
+	if(DRAWQ_SIZE - used < size){
+		q.stalls++;
+		do {
+			_drawq_wait();
+			used = q.pos - __atomic_load_n(&q.tail, __ATOMIC_ACQUIRE);
+		} while(DRAWQ_SIZE - used < size);
+	}
+	if(used + size > q.high_water) q.high_water = used + size;
+
+	q.buf[q.pos++ & DRAWQ_MASK] = len;
+	q.buf[q.pos++ & DRAWQ_MASK] = len >> 8;
+	for(uint16_t i = 0; i < len; i++) q.buf[q.pos++ & DRAWQ_MASK] = list[i];
+	__atomic_store_n(&q.head, q.pos, __ATOMIC_SEQ_CST);
+	_drawq_wake();
+}
+
+// draws what the parser has published, freeing each list once drawn
+static uint16_t _drawq_run(void){
+	uint32_t head = __atomic_load_n(&q.head, __ATOMIC_ACQUIRE);
+	uint16_t n = 0;
+	while(q.next != head){
+		// lists are executed in one piece, they may wrap in the ring
+		uint16_t len = q.buf[q.next++ & DRAWQ_MASK];
+		len |= q.buf[q.next++ & DRAWQ_MASK] << 8;
+		for(uint16_t i = 0; i < len; i++) q.list[i] = q.buf[q.next++ & DRAWQ_MASK];
+		dlist_exec(q.list, len);
+		__atomic_store_n(&q.tail, q.next, __ATOMIC_RELEASE);
+		n++;
+	}
+	return n;
+}
+
+#if defined(VT100_HOST)
+static void *_drawq_thread(void *arg){
+	(void)arg;
+	for(;;) if(!_drawq_run()) _drawq_idle();
+	return 0;
+}
+
+void drawq_start(void){
+	pthread_t thread;
+	pthread_create(&thread, 0, _drawq_thread, 0);
+	pthread_detach(thread);
+}
+#else
+static void _drawq_task(void *arg){
+	(void)arg;
+	for(;;) if(!_drawq_run()) _drawq_idle();
+}
+
+void drawq_start(void){
+	xTaskCreatePinnedToCore(_drawq_task, "drawq", 4096, 0, 1, &q.task, DRAWQ_CORE);
+}
+#endif
+
+void drawq_sync(void){
+	while(__atomic_load_n(&q.tail, __ATOMIC_ACQUIRE) != q.pos) _drawq_wait();
+}
+
+uint16_t drawq_used(void){
+	return q.pos - __atomic_load_n(&q.tail, __ATOMIC_ACQUIRE);
+}
+
+uint32_t drawq_stalls(void){
+	return q.stalls;
+}
+
+uint16_t drawq_highWater(void){
+	return q.high_water;
+}
+
+#endif
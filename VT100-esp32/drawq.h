@@ -0,0 +1,70 @@
+// Draw queue between the parser and the renderer
+//
+// On a dual core ESP32 the terminal can run as a pipeline: the loop()
+// core reads the serial port and runs the parser, and every display list
+// it flushes (dlist.h) is copied into this queue whole. A render task on
+// the other core takes the lists out and executes them with the real
+// driver, so parsing goes on while the SPI bus is busy.
+//
+// The queue is a single producer / single consumer ring without locks:
+// only the parser moves the head and only the renderer moves the tail,
+// each published with release and read with acquire ordering. A list is
+// written completely before the head moves past it, and freed only after
+// it has been drawn.
+//
+// When the ring is full the parser waits for room (drawq_stalls() counts
+// how often). The sketch avoids most of that by not parsing while more
+// than DRAWQ_HIGH_WATER bytes are queued, which leaves the input in the
+// receive ring, where the usual flow control stops the host.
+//
+// Set VT100_PIPELINE to 1 to build it. It needs a second core: the ESP32,
+// or a second thread on the host, and VT100_DLIST. At 0, the default,
+// display lists are executed where they are flushed and none of this is
+// compiled in.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+//#define VT100_PIPELINE 1
+
+#ifndef VT100_PIPELINE
+#define VT100_PIPELINE 0
+#endif
+
+#if VT100_PIPELINE && !defined(ESP32) && !defined(VT100_HOST)
+#error "VT100_PIPELINE needs a second core"
+#endif
+
+// must be a power of two and hold a display list (DLIST_SIZE) and its
+// length
+#ifndef DRAWQ_SIZE
+#define DRAWQ_SIZE 8192
+#endif
+#ifndef DRAWQ_HIGH_WATER
+#define DRAWQ_HIGH_WATER (DRAWQ_SIZE / 2)
+#endif
+
+// core the ESP32 render task runs on, loop() has the other one
+#ifndef DRAWQ_CORE
+#define DRAWQ_CORE 0
+#endif
+
+#if VT100_PIPELINE
+
+// starts the renderer: a task on DRAWQ_CORE on the ESP32, a thread on the
+// host. The display must be set up first.
+void drawq_start(void);
+// waits until the renderer has drawn everything queued
+void drawq_sync(void);
+// bytes queued and not yet drawn
+uint16_t drawq_used(void);
+// times the parser had to wait for room, and the most ever queued
+uint32_t drawq_stalls(void);
+uint16_t drawq_highWater(void);
+
+// queues a display list, waiting for room when the ring is full
+void drawq_write(const uint8_t *list, uint16_t len);
+
+#endif
@@ -0,0 +1,16 @@
+// EEPROM stand-in for host builds, kept in memory
+
+#pragma once
+
+#include <stdint.h>
+
+class EEPROMClass {
+public:
+	uint8_t read(int addr){ return mem[addr & 0xfff]; }
+	void write(int addr, uint8_t val){ mem[addr & 0xfff] = val; }
+	void update(int addr, uint8_t val){ mem[addr & 0xfff] = val; }
+private:
+	uint8_t mem[4096];
+};
+
+extern EEPROMClass EEPROM;
@@ -0,0 +1,56 @@
+// The parts of the Arduino core the terminal uses, for host builds
+//
+// vt100.cpp and uart.cpp include <arduino.h>. On the host this header
+// stands in for it: the serial ports take and give nothing, and time is
+// what host_advance() says, so runs are repeatable.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+
+#define _BV(bit) (1 << (bit))
+
+// no separate program memory on the host
+#ifndef PROGMEM
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#endif
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+
+class HardwareSerial {
+public:
+	void begin(unsigned long baud){ (void)baud; }
+	void end(void){}
+	int available(void){ return 0; }
+	int availableForWrite(void){ return 64; }
+	int read(void){ return -1; }
+	size_t write(uint8_t c){ (void)c; return 1; }
+	size_t write(const uint8_t *buf, size_t len){ (void)buf; return len; }
+	size_t print(const char *str){ return strlen(str); }
+};
+
+extern HardwareSerial Serial, Serial1;
+
+static inline void pinMode(uint8_t pin, uint8_t mode){ (void)pin; (void)mode; }
+static inline void digitalWrite(uint8_t pin, uint8_t val){ (void)pin; (void)val; }
+static inline void interrupts(void){}
+
+unsigned long millis(void);
+unsigned long micros(void);
+
+// moves the host clock on
+void host_advance(unsigned long us);
+// asks the terminal for its profile (ESC [ ? 100 n) and prints the
+// reply, when it is built with VT100_PROFILE
+struct vt100;
+void host_printProfile(struct vt100 *t);
+// zeroes the profile and the latency histogram, which only the first
+// vt100_init() does, before a run that reports them
+void host_clearStats(void);
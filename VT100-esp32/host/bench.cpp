@@ -0,0 +1,286 @@
+// Throughput benchmark for the host build
+//
+// Replays canned terminal streams through vt100_write() into the host
+// panel (the ILI9340 emulation in tft_host.cpp, or the RA8876 model with
+// VT100_RA8876) and reports for each stream:
+//
+//   MB/s        input bytes per second of host CPU time, parser, renderer
+//               and panel emulation together
+//   calls/byte  drawing calls made through display.h per input byte
+//   spi/byte    bytes sent over the panel bus per input byte
+//   p99 us      99th percentile latency from a chunk's first byte coming
+//               in to the repaint that shows it (latency.h). Drawing takes
+//               no host clock time, so this is what frame pacing adds.
+//
+// usage: vt100_bench [chunk [baud [hz [repeat]]]]
+//
+//   chunk   bytes per vt100_write(), as the receive ring hands them over
+//           (64)
+//   baud    line speed the input arrives at. The host clock follows it,
+//           so it decides how much input goes into each frame (115200).
+//   hz      vt100_setRefreshRate(), 0 repaints after every write (30, as
+//           in vt_test.ino)
+//   repeat  runs of each stream, for steadier timing (3)
+//
+// Built with VT100_PROFILE, the profile of each stream's last run follows
+// its line.
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "arduino.h"
+#include "display.h"
+#include "latency.h"
+#include "tft.h"
+#include "vt100.h"
+
+#define BENCH_MAX (512 * 1024UL)
+
+// the stream being generated
+static struct bench_stream {
+	char buf[BENCH_MAX];
+	size_t len;
+	uint32_t seed;
+	uint16_t cols, rows;
+} out;
+
+static void _bench_printf(const char *fmt, ...){
+	va_list ap;
+	va_start(ap, fmt);
+	int n = vsnprintf(out.buf + out.len, BENCH_MAX - out.len, fmt, ap);
+	va_end(ap);
+	if(n > 0) out.len += ((size_t)n < BENCH_MAX - out.len)?(size_t)n:BENCH_MAX - out.len - 1;
+}
+
+// a line cut to the screen width, cleared to its end
+static void _bench_line(const char *fmt, ...){
+	char line[256];
+	va_list ap;
+	va_start(ap, fmt);
+	vsnprintf(line, sizeof(line), fmt, ap);
+	va_end(ap);
+	if(strlen(line) >= out.cols) line[out.cols - 1] = 0;
+	_bench_printf("%s\e[K\r\n", line);
+}
+
+// same numbers on every run and every machine
+static uint32_t _bench_rand(uint32_t n){
+	out.seed = out.seed * 1103515245 + 12345;
+	return (out.seed >> 16) % n;
+}
+
+// dmesg / build log scrolling past as fast as it comes
+static void _bench_log(void){
+	static const char *const msgs[] = {
+		"usb 1-1: new high-speed USB device number %u using ehci-pci",
+		"EXT4-fs (sda%u): mounted filesystem with ordered data mode",
+		"eth0: link up, %u Mbps, full duplex",
+		"systemd[1]: Started Session %u of user pi.",
+		"gcc -O2 -c src/module%u.c -o build/module.o",
+	};
+	for(uint16_t i = 0; i < 3000; i++){
+		_bench_printf("[%5u.%06u] ", i / 10, _bench_rand(1000000));
+		_bench_printf(msgs[_bench_rand(5)], _bench_rand(1000));
+		_bench_printf("\r\n");
+	}
+}
+
+// top redrawing its whole screen from home every frame
+static void _bench_top(void){
+	static const char *const users[] = { "root", "pi", "www-data", "mysql" };
+	static const char *const commands[] = { "python3", "sshd", "nginx", "mysqld", "systemd", "kworker/0:1", "top", "bash" };
+	for(uint16_t frame = 0; frame < 60; frame++){
+		_bench_printf("\e[H");
+		_bench_line("top - 12:%02u:%02u up 3 days,  2 users,  load average: 0.%02u, 0.%02u, 0.%02u",
+			frame / 60, frame % 60, _bench_rand(100), _bench_rand(100), _bench_rand(100));
+		_bench_line("Tasks: %3u total,   1 running, %3u sleeping,   0 stopped,   0 zombie",
+			180 + _bench_rand(5), 170 + _bench_rand(5));
+		_bench_line("%%Cpu(s): %2u.%u us,  1.2 sy,  0.0 ni, %2u.%u id",
+			_bench_rand(30), _bench_rand(10), 60 + _bench_rand(30), _bench_rand(10));
+		_bench_line("MiB Mem :   3906.0 total,   %4u.0 free", 1000 + _bench_rand(2000));
+		_bench_line("");
+		_bench_printf("\e[30;47m");
+		_bench_line("  PID USER      PR  NI    RES  %%CPU COMMAND");
+		_bench_printf("\e[m");
+		for(uint16_t row = 6; row < out.rows - 1; row++){
+			_bench_line("%5u %-8s  20   0 %6u %2u.%u %s", 100 + row * 37, users[_bench_rand(4)],
+				_bench_rand(200000), _bench_rand(40), _bench_rand(10), commands[_bench_rand(8)]);
+		}
+		_bench_printf("\e[J");
+	}
+}
+
+static void _bench_code(void){
+	static const char *const lines[] = {
+		"\e[32m#include\e[m \e[31m<stdio.h>\e[m",
+		"\e[33mstatic\e[m \e[32mint\e[m count;",
+		"\e[33mif\e[m(x > %u){",
+		"\treturn \e[35m%u\e[m;",
+		"}",
+		"\e[34m// keep the old value\e[m",
+		"\e[33mfor\e[m(i = \e[35m0\e[m; i < n; i++)",
+		"\tsum += buf[i] * \e[35m%u\e[m;",
+		"",
+	};
+	_bench_printf(lines[_bench_rand(9)], _bench_rand(100));
+	_bench_printf("\e[K");
+}
+
+// vim on the alternate screen: a scroll region above the status line,
+// scrolling both ways and lines opened and deleted in the middle
+static void _bench_vim(void){
+	uint16_t bottom = out.rows - 1; // last row of the region
+	_bench_printf("\e[?1049h\e[H\e[2J\e[1;%ur", out.rows);
+	for(uint16_t row = 1; row <= bottom; row++){
+		_bench_printf("\e[%u;1H", row);
+		_bench_code();
+	}
+	for(uint16_t i = 0; i < 400; i++){
+		switch(i % 8){
+			case 5: case 6: // scroll back: reverse index at the top
+				_bench_printf("\e[1;1H\eM");
+				_bench_code();
+				break;
+			case 7: // open a line, then delete another
+				_bench_printf("\e[%u;1H\e[L", 2 + _bench_rand(bottom - 2));
+				_bench_code();
+				_bench_printf("\e[%u;1H\e[M\e[%u;1H", 2 + _bench_rand(bottom - 2), bottom);
+				_bench_code();
+				break;
+			default: // line feed at the bottom
+				_bench_printf("\e[%u;1H\n\r", bottom);
+				_bench_code();
+				break;
+		}
+		_bench_printf("\e[%u;1H\e[30;47m\"main.c\" %u,1\e[m\e[K", out.rows, i + 1);
+	}
+	_bench_printf("\e[r\e[?1049l");
+}
+
+// ls --color: short coloured names in columns
+static void _bench_ls(void){
+	static const char *const colors[] = { "01;34", "01;32", "0", "01;31", "01;36", "0" };
+	static const char *const names[] = {
+		"src", "build.sh", "README.md", "backup.tgz", "lib", "main.c",
+		"Makefile", "docs", "vt100.o", "tags", "config", "test"
+	};
+	for(uint16_t i = 0; i < 300; i++){
+		_bench_printf("\e[32mpi@term\e[m:\e[34m~/src\e[m$ ls --color\r\n");
+		uint16_t col = 0;
+		for(uint8_t n = 0; n < 20; n++){
+			if(col + 12 > out.cols){
+				_bench_printf("\r\n");
+				col = 0;
+			}
+			const char *name = names[_bench_rand(12)];
+			_bench_printf("\e[%sm%s\e[0m%*s", colors[_bench_rand(6)], name, (int)(12 - strlen(name)), "");
+			col += 12;
+		}
+		_bench_printf("\r\n");
+	}
+}
+
+// watch-like full clears with a little text in between
+static void _bench_clear(void){
+	for(uint16_t i = 0; i < 500; i++){
+		_bench_printf((i & 1)?"\e[H\e[J":"\e[H\e[2J");
+		_bench_printf("Every 2.0s: uptime\r\n\r\n");
+		_bench_printf(" 12:%02u:%02u up 3 days, load average: 0.%02u\r\n", i / 60, i % 60, _bench_rand(100));
+	}
+}
+
+static const struct bench_case {
+	const char *name;
+	void (*generate)(void);
+} cases[] = {
+	{ "log", _bench_log },
+	{ "top", _bench_top },
+	{ "vim", _bench_vim },
+	{ "ls", _bench_ls },
+	{ "clear", _bench_clear },
+};
+
+// feeds the stream to a fresh terminal repeat times, in chunks through
+// vt100_write() or a byte at a time through vt100_putc(), and returns the
+// CPU time it took. calls and spi get the drawing calls and bus bytes of
+// the last pass.
+static clock_t _bench_run(size_t chunk, uint32_t baud, uint8_t hz, uint8_t repeat, uint8_t bytewise,
+	struct vt100 **term, uint32_t *calls, uint32_t *spi){
+	clock_t cpu = 0;
+	for(uint8_t r = 0; r < repeat; r++){
+		display_init();
+		display_setRotation(0);
+		*term = vt100_init(0);
+		host_clearStats();
+		vt100_setRefreshRate(*term, hz);
+		display_sync();
+		*calls = display_calls;
+		*spi = tft_hostBytes();
+		clock_t start = clock();
+		// the host clock moves on by the time the input took to arrive
+		uint64_t arrived = 0;
+		for(size_t i = 0; i < out.len; i += chunk){
+			size_t len = (out.len - i < chunk)?out.len - i:chunk;
+			uint64_t now = (uint64_t)(i + len) * 10 * 1000000 / baud;
+			vt100_stamp(*term, micros());
+			host_advance(now - arrived);
+			arrived = now;
+			if(bytewise){
+				for(size_t n = 0; n < len; n++) vt100_putc(*term, (uint8_t)out.buf[i + n]);
+			} else {
+				vt100_write(*term, (const uint8_t *)out.buf + i, len);
+			}
+		}
+		vt100_flush(*term);
+		cpu += clock() - start;
+		*calls = display_calls - *calls;
+		*spi = tft_hostBytes() - *spi;
+	}
+	return cpu;
+}
+
+static double _bench_rate(clock_t cpu, uint8_t repeat){
+	double seconds = (double)cpu / CLOCKS_PER_SEC;
+	return seconds?(double)out.len * repeat / seconds / 1e6:0.0;
+}
+
+int main(int argc, char **argv){
+	size_t chunk = (argc > 1)?atoi(argv[1]):64;
+	uint32_t baud = (argc > 2)?atol(argv[2]):115200;
+	uint8_t hz = (argc > 3)?atoi(argv[3]):30;
+	uint8_t repeat = (argc > 4)?atoi(argv[4]):3;
+	if(!chunk || !baud || !repeat) return 1;
+
+	display_init();
+	display_setRotation(0);
+#if defined(VT100_RA8876)
+	printf("RA8876");
+#else
+	printf("ILI9340");
+#endif
+	printf(" %ux%u, %u x %u cells, chunk %u, %lu baud, %u Hz\n\n", display_width(), display_height(),
+		VT100_WIDTH, VT100_HEIGHT, (unsigned)chunk, (unsigned long)baud, hz);
+	// write is MB/s through vt100_write(), putc the same stream a byte at a
+	// time through vt100_putc(); drawing and latency are from the write pass
+	printf("%-6s %8s %8s %8s %11s %9s %8s\n", "stream", "bytes", "write", "putc", "calls/byte", "spi/byte", "p99 us");
+
+	for(uint8_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++){
+		out.len = 0;
+		out.seed = 1;
+		out.cols = VT100_WIDTH;
+		out.rows = VT100_HEIGHT;
+		cases[c].generate();
+
+		uint32_t calls, spi;
+		struct vt100 *term = 0;
+		clock_t putc_cpu = _bench_run(chunk, baud, hz, repeat, 1, &term, &calls, &spi);
+		clock_t write_cpu = _bench_run(chunk, baud, hz, repeat, 0, &term, &calls, &spi);
+		printf("%-6s %8lu %8.2f %8.2f %11.3f %9.2f %8lu\n", cases[c].name, (unsigned long)out.len,
+			_bench_rate(write_cpu, repeat), _bench_rate(putc_cpu, repeat),
+			(double)calls / out.len, (double)spi / out.len, (unsigned long)latency_percentile(99));
+		host_printProfile(term);
+	}
+	return 0;
+}
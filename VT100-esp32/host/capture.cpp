@@ -0,0 +1,42 @@
+// Capture file reader, the format is described in capture.h
+
+#include <string.h>
+
+#include "capture.h"
+
+static uint32_t _capture_le(const uint8_t *p, uint8_t len){
+	uint32_t v = 0;
+	while(len--) v = (v << 8) | p[len];
+	return v;
+}
+
+int capture_open(struct capture *c, const char *path){
+	uint8_t header[8];
+	c->file = fopen(path, "rb");
+	if(!c->file) return 0;
+	if(fread(header, 1, sizeof(header), c->file) != sizeof(header) || memcmp(header, CAPTURE_MAGIC, 4)){
+		capture_close(c);
+		return 0;
+	}
+	c->cols = _capture_le(header + 4, 2);
+	c->rows = _capture_le(header + 6, 2);
+	return 1;
+}
+
+int capture_read(struct capture *c, struct capture_record *r){
+	uint8_t header[7];
+	size_t n = fread(header, 1, sizeof(header), c->file);
+	if(n == 0) return 0;
+	if(n != sizeof(header)) return -1;
+	r->type = header[0];
+	r->time = _capture_le(header + 1, 4);
+	r->len = _capture_le(header + 5, 2);
+	if(r->type != CAPTURE_DATA && r->type != CAPTURE_CHECK) return -1;
+	if(fread(r->data, 1, r->len, c->file) != r->len) return -1;
+	return 1;
+}
+
+void capture_close(struct capture *c){
+	if(c->file) fclose(c->file);
+	c->file = 0;
+}
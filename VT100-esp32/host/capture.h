@@ -0,0 +1,48 @@
+// Capture files: a serial stream with timestamps, for replaying into the
+// terminal
+//
+// All numbers are little endian. The file starts with an 8 byte header
+//
+//   "VTC1"  magic
+//   u16     columns and
+//   u16     rows the stream was recorded for
+//
+// followed by records:
+//
+//   u8      type, CAPTURE_DATA or CAPTURE_CHECK
+//   u32     microseconds since the start of the capture
+//   u16     payload length
+//   ...     payload, the bytes received for CAPTURE_DATA, empty for
+//           CAPTURE_CHECK
+//
+// A check record is a point where the screen is compared with its golden
+// hash. record.py puts one wherever the output went idle and one at the
+// end.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define CAPTURE_MAGIC "VTC1"
+#define CAPTURE_DATA 'd'
+#define CAPTURE_CHECK 'c'
+
+struct capture {
+	FILE *file;
+	uint16_t cols, rows;
+};
+
+struct capture_record {
+	uint8_t type;
+	uint32_t time;
+	uint16_t len;
+	uint8_t data[65535];
+};
+
+// opens a capture and reads its header, returns 0 if it isn't one
+int capture_open(struct capture *c, const char *path);
+// reads the next record, returns 0 at the end and -1 if the file is cut
+// short or has an unknown record type
+int capture_read(struct capture *c, struct capture_record *r);
+void capture_close(struct capture *c);
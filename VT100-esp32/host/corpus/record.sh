@@ -0,0 +1,24 @@
+#!/bin/bash
+# Re-records the capture corpus. The captures are kept in git, so this is
+# only needed to add to them - anything recorded again will differ in its
+# timing and output, and needs new golden hashes:
+#
+#   vt100_replay -w corpus/ili9340.golden corpus/*.vtc
+#   vt100_replay_ra8876 -w corpus/ra8876.golden corpus/*.vtc
+
+set -e
+cd "$(dirname "$0")"
+REC=../record.py
+SRC=../..
+
+for group in cursor erase scroll margins insdel attrs tabs save altscreen; do
+	$REC $group.vtc ./vttest.sh $group
+done
+
+# real programs, with colours where they have them
+$REC -t xterm flood.vtc cat $SRC/vt100.cpp
+$REC -t xterm ls.vtc ls --color=always -C /usr/include /usr/lib
+$REC -t xterm top.vtc top -d 0.5 -n 6
+$REC -t xterm -k ' bbbb/vt100_write\rnnnq' less.vtc less $SRC/ili9340.cpp
+$REC -t xterm -k '\x06\x06\x04jjjjjjjjjjkkkkk\x15\x19\x19\x05\x05ddOnew line\x1bu:q!\r' vim.vtc \
+	vim -u NONE -N -c 'syntax on' $SRC/vt100.cpp
@@ -0,0 +1,158 @@
+#!/bin/bash
+# vttest style screens for the capture corpus, one group per argument:
+#
+#   cursor erase scroll margins insdel attrs tabs save altscreen
+#
+# Each pause lets record.py put a check in. The screens are sized from
+# the terminal, so record them at the size they are meant for.
+
+read ROWS COLS < <(stty size)
+MID_ROW=$((ROWS / 2))
+MID_COL=$((COLS / 2))
+
+at() { printf '\033[%d;%dH%s' "$1" "$2" "$3"; }
+pause() { sleep 0.3; }
+home() { printf '\033[H\033[2J'; }
+
+cursor() {
+	home
+	# a frame of * placed with absolute moves
+	for ((c = 1; c <= COLS; c++)); do at 1 $c '*'; at $ROWS $c '*'; done
+	for ((r = 2; r < ROWS; r++)); do at $r 1 '*'; at $r $COLS '*'; done
+	pause
+	# and a frame of + inside it with relative ones
+	printf '\033[2;2H'
+	for ((c = 2; c < COLS; c++)); do printf '+'; done
+	for ((r = 3; r < ROWS; r++)); do printf '\033[B\033[D+'; done
+	for ((c = COLS - 2; c >= 2; c--)); do printf '\033[2D+'; done
+	for ((r = ROWS - 2; r >= 3; r--)); do printf '\033M\033[D+'; done
+	pause
+	at $((MID_ROW - 1)) 4 'The screen should'
+	printf '\033E\033[3Chave two frames'
+	printf '\033D\r\033[3Cof * and +'
+	printf '\033[2A\033[20Cx\033[3B\033[3Dy\033[1;1H'
+	pause
+}
+
+erase() {
+	home
+	for ((r = 1; r <= ROWS; r++)); do
+		at $r 1 ''
+		for ((c = 1; c <= COLS; c++)); do printf "\\x$(printf %x $((65 + (r + c) % 26)))"; done
+	done
+	pause
+	printf '\033[%d;%dH\033[1K' $((MID_ROW - 2)) $MID_COL
+	printf '\033[%d;%dH\033[K' $MID_ROW $MID_COL
+	printf '\033[%d;%dH\033[2K' $((MID_ROW + 2)) $MID_COL
+	pause
+	printf '\033[5;10H\033[1J'
+	printf '\033[%d;10H\033[J' $((ROWS - 4))
+	pause
+	printf '\033[44m\033[%d;1H\033[K\033[%d;5H\033[1K\033[m' $((MID_ROW + 4)) $((MID_ROW + 6))
+	pause
+	printf '\033[2J'
+	pause
+}
+
+scroll() {
+	home
+	printf '\033[5;%dr\033[%d;1H' $((ROWS - 4)) $((ROWS - 5))
+	for ((i = 1; i <= ROWS * 2; i++)); do printf '\nregion line %d' $i; done
+	at 1 1 'above the region'
+	at $ROWS 1 'below the region'
+	pause
+	printf '\033[5;1H'
+	for ((i = 1; i <= 8; i++)); do printf '\033Mreverse %d\r' $i; done
+	pause
+	printf '\033[%d;1H' $((ROWS - 5))
+	for ((i = 1; i <= 6; i++)); do printf '\033Dindex %d\r' $i; done
+	printf '\033Enext line'
+	pause
+	printf '\033[r\033[%d;1H' $ROWS
+	for ((i = 1; i <= 12; i++)); do printf '\nscreen line %d' $i; done
+	pause
+	printf '\033[?6h\033[3;%dr\033[1;1Horigin\033[2J' $((ROWS - 2))
+	printf '\033[?6l\033[r'
+	pause
+}
+
+# DECSTBM edge cases: the bottom value is the last row of the region,
+# a missing or zero value is the screen edge, a bottom below the screen
+# is cut to its last row and a region of less than two rows resets it
+margins() {
+	local case
+	for case in '5;10' '5' ';10' '0;0' "5;$((ROWS + 20))" '10;5' '7;7'; do
+		home
+		for ((r = 1; r <= ROWS; r++)); do at $r 1 "row $r"; done
+		# line feeds from row 8 on scroll the region once they reach its
+		# last row, the rows outside it stay
+		printf '\033[%sr\033[8;1H' "$case"
+		for ((i = 1; i <= ROWS; i++)); do printf '\nfed %d (%s)' $i "$case"; done
+		at 1 20 "top $case"
+		pause
+	done
+	printf '\033[r'
+}
+
+insdel() {
+	home
+	for ((r = 1; r <= ROWS; r++)); do at $r 1 "line $r"; done
+	pause
+	printf '\033[5;1H\033[L\033[10;1H\033[3L\033[15;1H\033[M\033[20;3H\033[4M'
+	pause
+	printf '\033[6;%dr\033[8;1H\033[2Lin region\033[12;1H\033[5M\033[r' $((ROWS - 6))
+	pause
+	printf '\033[1;1H\033[%dM' $((ROWS * 2))
+	pause
+}
+
+attrs() {
+	home
+	for fg in 0 1 2 3 4 5 6 7; do
+		at $((fg + 2)) 1 ''
+		for bg in 0 1 2 3 4 5 6 7; do printf '\033[3%d;4%dm%d%d\033[m ' $fg $bg $fg $bg; done
+	done
+	pause
+	printf '\033[12;1H\033[41mred background to the end\033[K\033[m'
+	printf '\033[13;1H\033[32;45mgreen on magenta\033[0m default\r\n'
+	printf '\033[33m\033[44m\033[K\033[myellow? no, cleared\r\n'
+	pause
+}
+
+tabs() {
+	home
+	printf 'a\tb\tc\td\r\n'
+	printf 'tab\tstops\tevery\tfour\r\n'
+	printf '\033[?7h'
+	for ((c = 0; c < COLS + 10; c++)); do printf '%d' $((c % 10)); done
+	printf '\r\n\033[?7l'
+	for ((c = 0; c < COLS + 10; c++)); do printf '%d' $((c % 10)); done
+	printf '\r\noverprint\rOVER\r\n'
+	printf 'back\b\b\bXY\r\n'
+	printf 'control \001\002\003 shown\r\n'
+	pause
+}
+
+save() {
+	home
+	printf '\033[31mred \x1b7\033[10;10H\033[34mblue \x1b8again red\033[m'
+	printf '\033[20;5Hsaved\033[s\033[1;1Hmoved\033[uback'
+	printf '\033[30;1H\033[6n\033[5n\033[c'
+	pause
+}
+
+altscreen() {
+	home
+	for ((r = 1; r <= ROWS; r += 3)); do at $r 1 "main screen row $r"; done
+	at 10 5 ''
+	pause
+	printf '\033[?1049h'
+	for ((r = 1; r <= ROWS; r += 2)); do at $r 3 "alternate $r"; done
+	pause
+	printf '\033[?1049lcursor back\033[?47h\033[Hon 47'
+	pause
+	printf '\033[?47l'
+	pause
+}
+
+for group in "$@"; do $group; done
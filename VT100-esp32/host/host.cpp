@@ -0,0 +1,46 @@
+// Objects and clock behind arduino.h and EEPROM.h on the host
+
+#include "arduino.h"
+#include "EEPROM.h"
+#include "latency.h"
+#include "profile.h"
+#include "vt100.h"
+
+HardwareSerial Serial, Serial1;
+EEPROMClass EEPROM;
+
+// the render thread of VT100_PIPELINE builds reads it as well
+static unsigned long host_us;
+
+unsigned long micros(void){
+	return __atomic_load_n(&host_us, __ATOMIC_RELAXED);
+}
+
+unsigned long millis(void){
+	return micros() / 1000;
+}
+
+void host_advance(unsigned long us){
+	__atomic_fetch_add(&host_us, us, __ATOMIC_RELAXED);
+}
+
+void host_printProfile(struct vt100 *t){
+#if VT100_PROFILE
+	const uint8_t *reply;
+	size_t len;
+	vt100_write(t, (const uint8_t *)"\e[?100n", 7);
+	while((len = vt100_txChunk(t, &reply))){
+		fwrite(reply, 1, len, stdout);
+		vt100_txConsume(t, len);
+	}
+#else
+	(void)t;
+#endif
+}
+
+void host_clearStats(void){
+#if VT100_PROFILE
+	profile_init();
+#endif
+	latency_clear();
+}
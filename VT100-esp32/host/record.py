@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+"""Records what a program sends to its terminal as a capture (capture.h)
+
+usage: record.py [-s COLSxROWS] [-t TERM] [-k KEYS] [-i MS] out.vtc command...
+
+The command runs in a pseudo terminal of the given size (40x40, the
+ILI9340 screen, by default). Everything it writes is stored with the time
+it arrived. Whenever the output has been idle for MS milliseconds (100) a
+check record is added, and then the next of KEYS is typed, so every
+keystroke gets its own check. KEYS takes Python escapes ("\\x06" for
+ctrl-F, "\\x1b" for escape). Once the keys are used up the program gets
+two seconds to finish before it is killed.
+"""
+
+import argparse
+import fcntl
+import os
+import pty
+import select
+import signal
+import struct
+import sys
+import termios
+import time
+
+MAGIC = b"VTC1"
+DATA = b"d"
+CHECK = b"c"
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("-s", "--size", default="40x40")
+    parser.add_argument("-t", "--term", default="vt100")
+    parser.add_argument("-k", "--keys", default="")
+    parser.add_argument("-i", "--idle", type=int, default=100)
+    parser.add_argument("out")
+    parser.add_argument("command", nargs=argparse.REMAINDER)
+    args = parser.parse_args()
+    if not args.command:
+        parser.error("no command")
+    cols, rows = (int(n) for n in args.size.split("x"))
+    keys = args.keys.encode("latin-1").decode("unicode_escape").encode("latin-1")
+
+    pid, fd = pty.fork()
+    if pid == 0:
+        fcntl.ioctl(0, termios.TIOCSWINSZ, struct.pack("HHHH", rows, cols, 0, 0))
+        os.environ["TERM"] = args.term
+        os.environ["COLUMNS"] = str(cols)
+        os.environ["LINES"] = str(rows)
+        os.execvp(args.command[0], args.command)
+
+    records = []
+    start = last_out = time.monotonic()
+    idle = args.idle / 1000
+    pending = False  # output since the last check
+    while True:
+        ready, _, _ = select.select([fd], [], [], 0.01)
+        now = time.monotonic()
+        if ready:
+            try:
+                data = os.read(fd, 4096)
+            except OSError:  # the program has exited
+                break
+            if not data:
+                break
+            records.append((DATA, now - start, data))
+            pending = True
+            last_out = now
+        elif now - last_out >= idle:
+            if pending:
+                records.append((CHECK, now - start, b""))
+                pending = False
+            elif keys:
+                os.write(fd, keys[:1])
+                keys = keys[1:]
+                last_out = now
+            elif now - last_out >= 2:
+                os.kill(pid, signal.SIGKILL)
+                break
+    os.waitpid(pid, 0)
+    if pending:
+        records.append((CHECK, time.monotonic() - start, b""))
+
+    with open(args.out, "wb") as f:
+        f.write(MAGIC + struct.pack("<HH", cols, rows))
+        for kind, when, data in records:
+            f.write(kind + struct.pack("<IH", int(when * 1000000), len(data)) + data)
+    checks = sum(1 for r in records if r[0] == CHECK)
+    print("%s: %d bytes, %d checks" % (args.out, sum(len(r[2]) for r in records), checks))
+
+
+if __name__ == "__main__":
+    sys.exit(main())
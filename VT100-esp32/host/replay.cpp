@@ -0,0 +1,345 @@
+// Replays captures (capture.h) into the terminal and checks the screen
+//
+// Each capture is fed to vt100_write() as if it came in over the serial
+// port: records arrive at their recorded time, chunk bytes at a time at
+// the given baud rate, with the host clock following so frame pacing
+// works as on the device. At every check record the terminal is flushed,
+// as the sketch does when the input goes idle, and the panel is hashed
+// (tft_hostHash()). The hashes can be written to a golden file and later
+// compared against it, which makes any change to what ends up on the
+// panel show up, down to the pixel.
+//
+// usage: vt100_replay [options] capture...
+//
+//   -c chunk   bytes per vt100_write() (64)
+//   -b baud    line speed (115200)
+//   -r hz      vt100_setRefreshRate() (30)
+//   -j         jump scroll: tell the terminal (vt100_setBacklog()) that
+//              the rest of each record is already waiting, as if it had
+//              all come in at once
+//   -2         two at a time, see below
+//   -g file    compare the hashes with a golden file, exit 1 on any
+//              difference
+//   -w file    write the hashes as a new golden file
+//   -p dir     save the screen as dir/<capture>.<check>.ppm where it
+//              differs from the golden file, or at every check with -w
+//
+// Golden files have one "<capture> <check> <hash>" line per check. The
+// hashes depend on the display driver, so each has its own file.
+//
+// Besides the checks it prints the render cost of every capture: host CPU
+// time, drawing calls per input byte and bytes on the panel bus per input
+// byte, the 99th percentile latency from a chunk's first byte arriving to
+// the repaint that shows it (latency.h, host clock time, so frame pacing
+// only), and with VT100_PROFILE the profile table.
+//
+// vt100_replay_pipeline and vt100_replay_pipeline_ra8876 are built with
+// VT100_PIPELINE: the terminal queues its drawing (drawq.h) and a second
+// thread draws it, as the render core would on the ESP32. They must pass
+// the same golden files, which tests the queue with two threads. Their
+// latency mixes the host clock with how the threads get scheduled and
+// means nothing.
+//
+// With -2 the captures are taken in pairs and replayed together, each
+// into its own terminal (vt100_init()): the first in the top half of the
+// panel, with the hardware scroll, the second in the bottom half, which
+// scrolls in software. Their records are interleaved by time as if both
+// ports were streaming at once. At every check the pane of the capture
+// is hashed and compared with the same capture replayed alone in that
+// pane, so anything one terminal does to the other shows up. The golden
+// files don't apply to the halved screens.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "arduino.h"
+#include "capture.h"
+#include "display.h"
+#include "latency.h"
+#include "tft.h"
+#include "vt100.h"
+
+#define REPLAY_GOLDEN_MAX 4096
+#define REPLAY_STREAMS 2
+
+static struct replay_golden {
+	char name[64];
+	uint16_t check;
+	uint32_t hash;
+} golden[REPLAY_GOLDEN_MAX];
+static uint16_t golden_count;
+
+// a capture being fed to a terminal
+static struct replay_stream {
+	const char *name;
+	struct capture cap;
+	struct capture_record rec; // the next record, read ahead
+	int n; // what reading it returned, 0 at the end
+	struct vt100 *term;
+	// its viewport, in pixels
+	uint16_t x, y, w, h;
+	uint32_t bytes;
+	uint16_t checks, diffs;
+	// pane hashes at each check when replayed alone, for -2
+	uint32_t alone[REPLAY_GOLDEN_MAX];
+} streams[REPLAY_STREAMS];
+
+static struct replay_options {
+	size_t chunk;
+	uint32_t baud;
+	uint8_t hz;
+	int jump;
+	const char *check_path, *ppm_dir;
+	FILE *out;
+} opt = { 64, 115200, 30, 0, 0, 0, 0 };
+
+static int _replay_loadGolden(const char *path){
+	char line[128];
+	FILE *f = fopen(path, "r");
+	if(!f) return 0;
+	while(fgets(line, sizeof(line), f) && golden_count < REPLAY_GOLDEN_MAX){
+		struct replay_golden *g = &golden[golden_count];
+		unsigned check;
+		unsigned long hash;
+		if(sscanf(line, "%63s %u %lx", g->name, &check, &hash) != 3) continue;
+		g->check = check;
+		g->hash = hash;
+		golden_count++;
+	}
+	fclose(f);
+	return 1;
+}
+
+static struct replay_golden *_replay_findGolden(const char *name, uint16_t check){
+	for(uint16_t i = 0; i < golden_count; i++){
+		if(golden[i].check == check && !strcmp(golden[i].name, name)) return &golden[i];
+	}
+	return 0;
+}
+
+static int _replay_open(struct replay_stream *s, const char *path){
+	const char *name = strrchr(path, '/');
+	s->name = name?name + 1:path;
+	if(!capture_open(&s->cap, path)){
+		fprintf(stderr, "%s: not a capture\n", path);
+		return 0;
+	}
+	s->n = capture_read(&s->cap, &s->rec);
+	s->bytes = 0;
+	s->checks = s->diffs = 0;
+	return 1;
+}
+
+// the stream's terminal set up in the given pane, in characters
+static void _replay_term(struct replay_stream *s, uint8_t row, uint8_t rows, uint8_t hw_scroll){
+	s->x = 0;
+	s->y = row * VT100_CHAR_HEIGHT;
+	s->w = VT100_WIDTH * VT100_CHAR_WIDTH;
+	s->h = rows * VT100_CHAR_HEIGHT;
+	if(rows != VT100_HEIGHT || !hw_scroll) vt100_setViewport(s->term, s->x, s->y, VT100_WIDTH, rows, hw_scroll);
+	vt100_setRefreshRate(s->term, opt.hz);
+}
+
+// checks a whole panel screen against the golden file
+static void _replay_checkGolden(struct replay_stream *s){
+	uint32_t hash = tft_hostHash();
+	int save = opt.ppm_dir && opt.out;
+	if(opt.out) fprintf(opt.out, "%s %u %08lx\n", s->name, s->checks, (unsigned long)hash);
+	if(opt.check_path){
+		struct replay_golden *g = _replay_findGolden(s->name, s->checks);
+		if(!g || g->hash != hash){
+			if(g) printf("%s: check %u is %08lx, golden %08lx\n", s->name, s->checks, (unsigned long)hash, (unsigned long)g->hash);
+			else printf("%s: check %u is %08lx, no golden hash\n", s->name, s->checks, (unsigned long)hash);
+			save = opt.ppm_dir != 0;
+			s->diffs++;
+		}
+	}
+	if(save){
+		char path[256];
+		snprintf(path, sizeof(path), "%s/%s.%u.ppm", opt.ppm_dir, s->name, s->checks);
+		tft_hostSavePPM(path);
+	}
+}
+
+// keeps the pane's hash for the replay with the other capture
+static void _replay_checkAlone(struct replay_stream *s){
+	if(s->checks < REPLAY_GOLDEN_MAX) s->alone[s->checks] = tft_hostHashRect(s->x, s->y, s->w, s->h);
+}
+
+// and compares with it
+static void _replay_checkShared(struct replay_stream *s){
+	uint32_t hash = tft_hostHashRect(s->x, s->y, s->w, s->h);
+	if(s->checks < REPLAY_GOLDEN_MAX && hash == s->alone[s->checks]) return;
+	printf("%s: check %u is %08lx next to the other capture, %08lx alone\n", s->name, s->checks,
+		(unsigned long)hash, (unsigned long)(s->checks < REPLAY_GOLDEN_MAX?s->alone[s->checks]:0));
+	s->diffs++;
+}
+
+// feeds the streams to their terminals at their recorded times, whichever
+// has the earliest record first. At every check record the terminal is
+// flushed and check() looks at the panel. Returns the CPU time taken, not
+// counting the checks.
+static clock_t _replay_run(struct replay_stream *streams, uint8_t count, void (*check)(struct replay_stream *s)){
+	uint64_t now = 0; // host clock since the start of the captures
+	clock_t cpu = 0, start = clock();
+	for(;;){
+		struct replay_stream *s = 0;
+		for(uint8_t k = 0; k < count; k++){
+			if(streams[k].n > 0 && (!s || streams[k].rec.time < s->rec.time)) s = &streams[k];
+		}
+		if(!s) break;
+		struct capture_record *rec = &s->rec;
+		// the sketch repaints as soon as the input goes quiet, not
+		// when the recorder looked
+		if(rec->type != CAPTURE_DATA){
+			vt100_flush(s->term);
+			display_sync();
+		}
+		if(rec->time > now){
+			host_advance(rec->time - now);
+			now = rec->time;
+		}
+		if(rec->type == CAPTURE_DATA){
+			for(size_t i = 0; i < rec->len; i += opt.chunk){
+				size_t len = (rec->len - i < opt.chunk)?rec->len - i:opt.chunk;
+				// a chunk is handed over once all of it is in, its
+				// first byte is timed for the latency
+				uint32_t us = (uint64_t)len * 10 * 1000000 / opt.baud;
+				vt100_stamp(s->term, micros());
+				host_advance(us);
+				now += us;
+				if(opt.jump) vt100_setBacklog(s->term, rec->len - i - len);
+				vt100_write(s->term, rec->data + i, len);
+				// replies go nowhere
+				const uint8_t *reply;
+				size_t sent;
+				while((sent = vt100_txChunk(s->term, &reply))) vt100_txConsume(s->term, sent);
+				s->bytes += len;
+			}
+		} else {
+			cpu += clock() - start;
+			check(s);
+			s->checks++;
+			start = clock();
+		}
+		s->n = capture_read(&s->cap, rec);
+	}
+	display_sync();
+	return cpu + clock() - start;
+}
+
+// replays one capture over the whole panel and checks it against the
+// golden file
+static int _replay_one(const char *path){
+	struct replay_stream *s = &streams[0];
+	if(!_replay_open(s, path)) return 1;
+	display_init();
+	display_setRotation(0);
+	s->term = vt100_init(0);
+	host_clearStats();
+	_replay_term(s, 0, VT100_HEIGHT, 1);
+	display_sync();
+	uint32_t calls = display_calls, spi = tft_hostBytes();
+	clock_t cpu = _replay_run(s, 1, _replay_checkGolden);
+	capture_close(&s->cap);
+	if(s->n < 0){
+		printf("%s: cut short or damaged after %u checks\n", s->name, s->checks);
+		s->diffs++;
+	}
+
+	calls = display_calls - calls;
+	spi = tft_hostBytes() - spi;
+	printf("%-16s %8lu %6u %9.2f %11.3f %9.2f %8lu %8lu%s\n", s->name, (unsigned long)s->bytes, s->checks,
+		(double)cpu * 1000 / CLOCKS_PER_SEC, s->bytes?(double)calls / s->bytes:0.0, s->bytes?(double)spi / s->bytes:0.0,
+		(unsigned long)latency_percentile(99), (unsigned long)vt100_skipped(s->term), s->diffs?"  FAILED":"");
+	host_printProfile(s->term);
+	return s->diffs != 0;
+}
+
+// replays two captures, first each alone in its pane, then both at once
+static int _replay_pair(const char *top, const char *bottom){
+	const char *paths[REPLAY_STREAMS] = { top, bottom };
+	int failed = 0;
+	for(uint8_t pass = 0; pass <= REPLAY_STREAMS; pass++){
+		display_init();
+		display_setRotation(0);
+		// the panel size is only known once it is set up
+		uint8_t rows = VT100_HEIGHT / 2;
+		display_fillRect(0, 0, VT100_SCREEN_WIDTH, VT100_SCREEN_HEIGHT, DISPLAY_BLACK);
+		// vt100_init() takes the scroll window, so all of them first
+		for(uint8_t k = 0; k < REPLAY_STREAMS; k++) streams[k].term = vt100_init(k);
+		host_clearStats();
+		for(uint8_t k = 0; k < REPLAY_STREAMS; k++){
+			if(!_replay_open(&streams[k], paths[k])) return 1;
+			if(k == 0) _replay_term(&streams[k], 0, rows, 1);
+			else _replay_term(&streams[k], rows, VT100_HEIGHT - rows, 0);
+			// the panel and the terminals still hold the last pass
+			vt100_puts(streams[k].term, "\e[2J");
+			vt100_flush(streams[k].term);
+			// alone, the other one stays idle
+			if(pass < REPLAY_STREAMS && pass != k) streams[k].n = 0;
+		}
+		display_sync();
+		if(pass < REPLAY_STREAMS) _replay_run(streams, REPLAY_STREAMS, _replay_checkAlone);
+		else _replay_run(streams, REPLAY_STREAMS, _replay_checkShared);
+		for(uint8_t k = 0; k < REPLAY_STREAMS; k++){
+			if(streams[k].n < 0){
+				printf("%s: cut short or damaged after %u checks\n", streams[k].name, streams[k].checks);
+				failed = 1;
+			}
+			capture_close(&streams[k].cap);
+		}
+	}
+	struct replay_stream *a = &streams[0], *b = &streams[1];
+	printf("%-16s %-16s %4u+%-4u%s\n", a->name, b->name, a->checks, b->checks,
+		(a->diffs || b->diffs)?"  FAILED":"");
+	return failed || a->diffs || b->diffs;
+}
+
+int main(int argc, char **argv){
+	const char *write_path = 0;
+	int pairs = 0;
+	int c;
+	while((c = getopt(argc, argv, "c:b:r:j2g:w:p:")) != -1){
+		switch(c){
+			case 'c': opt.chunk = atoi(optarg); break;
+			case 'b': opt.baud = atol(optarg); break;
+			case 'r': opt.hz = atoi(optarg); break;
+			case 'j': opt.jump = 1; break;
+			case '2': pairs = 1; break;
+			case 'g': opt.check_path = optarg; break;
+			case 'w': write_path = optarg; break;
+			case 'p': opt.ppm_dir = optarg; break;
+			default: return 2;
+		}
+	}
+	if(optind >= argc || !opt.chunk || !opt.baud || (pairs && (argc - optind) % 2)){
+		fprintf(stderr, "usage: %s [-c chunk] [-b baud] [-r hz] [-j] [-2] [-g golden | -w golden] [-p dir] capture...\n", argv[0]);
+		return 2;
+	}
+	if(opt.check_path && !_replay_loadGolden(opt.check_path)){
+		fprintf(stderr, "%s: can't read\n", opt.check_path);
+		return 2;
+	}
+	if(write_path && !(opt.out = fopen(write_path, "w"))){
+		fprintf(stderr, "%s: can't write\n", write_path);
+		return 2;
+	}
+
+#if VT100_PIPELINE
+	drawq_start();
+#endif
+	int failed = 0;
+	if(pairs){
+		printf("%-16s %-16s %9s\n", "top", "bottom", "checks");
+		for(int a = optind; a < argc; a += 2) failed |= _replay_pair(argv[a], argv[a + 1]);
+	} else {
+		printf("%-16s %8s %6s %9s %11s %9s %8s %8s\n", "capture", "bytes", "checks", "cpu ms", "calls/byte", "spi/byte", "p99 us", "skipped");
+		for(int a = optind; a < argc; a++) failed |= _replay_one(argv[a]);
+	}
+	if(opt.out) fclose(opt.out);
+	return failed;
+}
@@ -0,0 +1,58 @@
+// Byte to pixel latency histogram, see latency.h
+
+#include <stdio.h>
+#include <string.h>
+
+#include "latency.h"
+
+static struct latency {
+	uint32_t buckets[LATENCY_BUCKETS];
+	uint32_t count, max;
+} lat;
+
+void latency_clear(void){
+	memset(&lat, 0, sizeof(lat));
+}
+
+void latency_add(uint32_t us){
+	uint8_t b = 0;
+	while(b < LATENCY_BUCKETS - 1 && (us >> (b + 1))) b++;
+	lat.buckets[b]++;
+	lat.count++;
+	if(us > lat.max) lat.max = us;
+}
+
+uint32_t latency_count(void){
+	return lat.count;
+}
+
+uint32_t latency_percentile(uint8_t pct){
+	if(!lat.count) return 0;
+	uint32_t want = ((uint64_t)lat.count * pct + 99) / 100, seen = 0;
+	for(uint8_t b = 0; b < LATENCY_BUCKETS - 1; b++){
+		seen += lat.buckets[b];
+		if(seen >= want){
+			uint32_t top = (2UL << b) - 1;
+			return (top < lat.max)?top:lat.max;
+		}
+	}
+	return lat.max;
+}
+
+uint8_t latency_line(uint8_t i, char *buf, uint8_t size){
+	int len;
+	if(i == 0){
+		len = snprintf(buf, size, "\r\nlatency: %lu samples, max %lu us\r\n",
+			(unsigned long)lat.count, (unsigned long)lat.max);
+	} else if(i == 1){
+		len = snprintf(buf, size, "p50 %lu us, p90 %lu us, p99 %lu us\r\n", (unsigned long)latency_percentile(50),
+			(unsigned long)latency_percentile(90), (unsigned long)latency_percentile(99));
+	} else {
+		uint8_t b = i - 2, last = LATENCY_BUCKETS - 1;
+		while(last && !lat.buckets[last]) last--;
+		if(b > last || !lat.count) return 0;
+		len = snprintf(buf, size, "%8lu - %8lu us %10lu\r\n", b?(1UL << b):0UL, (2UL << b) - 1,
+			(unsigned long)lat.buckets[b]);
+	}
+	return (len > 0 && len < size)?len:0;
+}
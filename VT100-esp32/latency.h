@@ -0,0 +1,29 @@
+// Byte to pixel latency
+//
+// One received byte at a time is timed, from the moment it went into the
+// receive ring (uart_rxStamp()) until the end of the repaint that put it
+// on the panel (vt100_stamp()). The times are counted in a histogram of
+// power of two buckets: bucket n holds 2^n to 2^(n+1) - 1 microseconds,
+// bucket 0 everything below 2.
+//
+// ESC [ ? 102 n sends the histogram to the host and ESC [ ? 103 n clears
+// it.
+
+#pragma once
+
+#include <stdint.h>
+
+// 1 us to 16 s
+#define LATENCY_BUCKETS 24
+
+void latency_clear(void);
+void latency_add(uint32_t us);
+uint32_t latency_count(void);
+// a latency that pct percent of the samples stay at or below: the top of
+// the bucket that percentile falls in, or the largest sample if that is
+// lower. 0 without samples.
+uint32_t latency_percentile(uint8_t pct);
+// formats line i of the histogram as text for the host, a summary and
+// then one line per bucket up to the highest used one. Returns its
+// length, 0 past the last line.
+uint8_t latency_line(uint8_t i, char *buf, uint8_t size);
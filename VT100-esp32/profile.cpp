@@ -0,0 +1,77 @@
+// Call and cycle counters, see profile.h
+
+#include "profile.h"
+
+#if VT100_PROFILE
+
+#include <stdio.h>
+#include <string.h>
+#if defined(__AVR__) && !defined(VT100_HOST)
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#endif
+
+static struct profile {
+	uint32_t calls[PROFILE_COUNT];
+	// a Teensy 4 runs through 32 bits of cycles in seven seconds
+	uint64_t cycles[PROFILE_COUNT];
+	volatile uint16_t overflows; // upper half of the AVR cycle count
+} prof;
+
+static const char *const profile_names[PROFILE_COUNT] = {
+	"ground", "escape", "esc inter", "csi entry", "csi param", "csi inter", "csi ignore", "string",
+	"print run", "execute", "esc dispatch", "csi dispatch",
+	"flush",
+	"drawChars", "drawString", "fillRect", "drawRect", "drawHLine", "drawVLine", "drawPixel", "drawLine",
+	"scrollStart", "scrollMargin", "copyRect", "setLayer",
+	"tft wait", "engine wait"
+};
+
+#if defined(__AVR__) && !defined(VT100_HOST)
+ISR(TIMER1_OVF_vect){
+	prof.overflows++;
+}
+
+uint32_t profile_cycles(void){
+	uint8_t sreg = SREG;
+	cli();
+	uint16_t low = TCNT1, high = prof.overflows;
+	// an overflow that came in before interrupts were shut out
+	if((TIFR1 & _BV(TOV1)) && low < 0x8000) high++;
+	SREG = sreg;
+	return ((uint32_t)high << 16) | low;
+}
+#endif
+
+void profile_init(void){
+	memset(prof.calls, 0, sizeof(prof.calls));
+	memset(prof.cycles, 0, sizeof(prof.cycles));
+#if defined(__AVR__) && !defined(VT100_HOST)
+	// normal mode, no prescaler
+	TCCR1A = 0;
+	TCCR1B = _BV(CS10);
+	TIMSK1 |= _BV(TOIE1);
+#endif
+}
+
+void profile_add(uint8_t id, uint32_t cycles){
+	prof.calls[id]++;
+	prof.cycles[id] += cycles;
+}
+
+uint8_t profile_line(uint8_t i, char *buf, uint8_t size){
+	int len;
+	if(i == 0){
+		len = snprintf(buf, size, "\r\n%-13s %10s %10s %10s\r\n", "profile", "calls", PROFILE_UNIT "/call", PROFILE_KUNIT);
+	} else if(i <= PROFILE_COUNT){
+		uint32_t calls = prof.calls[i - 1];
+		uint64_t cycles = prof.cycles[i - 1];
+		len = snprintf(buf, size, "%-13s %10lu %10lu %10lu\r\n", profile_names[i - 1], (unsigned long)calls,
+			(unsigned long)(calls?cycles / calls:0), (unsigned long)(cycles / 1000));
+	} else {
+		return 0;
+	}
+	return (len > 0 && len < size)?len:0;
+}
+
+#endif
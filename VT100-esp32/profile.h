@@ -0,0 +1,108 @@
+// Call and cycle counters for finding where the time goes
+//
+// With VT100_PROFILE set to 1 the terminal counts calls and adds up the
+// cycles spent per parser state, per dispatch, per drawing call through
+// display.h and waiting for the panel. ESC [ ? 100 n sends the table to
+// the host over the reply queue and ESC [ ? 101 n sets it back to zero.
+// At 0, the default, none of it is compiled in.
+//
+// Cycles are read from the CPU cycle counter on the Teensy 4
+// (ARM_DWT_CYCCNT) and the ESP32 (ccount), and from Timer1 at the CPU
+// clock on the AVR, which profile_init() takes over. Host builds count
+// nanoseconds instead.
+//
+// Entries nest: a parser state includes the dispatch it leads to, the
+// dispatch includes the drawing calls, and those include waiting for the
+// bus. On the AVR that wait is timed for every byte, which slows pixel
+// output down noticeably while profiling.
+
+#pragma once
+
+#include <stdint.h>
+
+#ifndef VT100_PROFILE
+#define VT100_PROFILE 0
+#endif
+
+#if VT100_PROFILE
+
+enum {
+	// bytes fed to the parser, by the state they arrive in (same order as
+	// the parser states in vt100.cpp)
+	PROFILE_GROUND,
+	PROFILE_ESCAPE,
+	PROFILE_ESC_INTER,
+	PROFILE_CSI_ENTRY,
+	PROFILE_CSI_PARAM,
+	PROFILE_CSI_INTER,
+	PROFILE_CSI_IGNORE,
+	PROFILE_STRING,
+	// runs of printable characters vt100_write() takes in one go
+	PROFILE_PRINT_RUN,
+	PROFILE_EXECUTE,
+	PROFILE_ESC_DISPATCH,
+	PROFILE_CSI_DISPATCH,
+	// repainting the dirty parts of the screen
+	PROFILE_FLUSH,
+	// drawing calls through display.h
+	PROFILE_DRAW_CHARS,
+	PROFILE_DRAW_STRING,
+	PROFILE_FILL_RECT,
+	PROFILE_DRAW_RECT,
+	PROFILE_DRAW_HLINE,
+	PROFILE_DRAW_VLINE,
+	PROFILE_DRAW_PIXEL,
+	PROFILE_DRAW_LINE,
+	PROFILE_SCROLL_START,
+	PROFILE_SCROLL_MARGINS,
+	PROFILE_COPY_RECT,
+	PROFILE_SET_LAYER,
+	// waiting for the panel: the SPI bus or DMA, and the RA8876 engines
+	PROFILE_TFT_WAIT,
+	PROFILE_ENGINE_WAIT,
+	PROFILE_COUNT
+};
+
+#if defined(VT100_HOST)
+#include <time.h>
+#define PROFILE_UNIT "ns"
+#define PROFILE_KUNIT "us"
+static inline uint32_t profile_cycles(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+#elif defined(__IMXRT1062__)
+#include <Arduino.h>
+#define PROFILE_UNIT "cyc"
+#define PROFILE_KUNIT "kcyc"
+static inline uint32_t profile_cycles(void){
+	return ARM_DWT_CYCCNT;
+}
+#elif defined(ESP32)
+#include <Arduino.h>
+#define PROFILE_UNIT "cyc"
+#define PROFILE_KUNIT "kcyc"
+static inline uint32_t profile_cycles(void){
+	return ESP.getCycleCount();
+}
+#else
+#define PROFILE_UNIT "cyc"
+#define PROFILE_KUNIT "kcyc"
+// Timer1, carried on into the upper half by its overflow interrupt
+uint32_t profile_cycles(void);
+#endif
+
+// clears the table (and starts the cycle counter where that is needed)
+void profile_init(void);
+void profile_add(uint8_t id, uint32_t cycles);
+// formats line i of the table, a header and then one line per entry, as
+// text for the host. Returns its length, 0 past the last line.
+uint8_t profile_line(uint8_t i, char *buf, uint8_t size);
+
+#define PROFILE_START(name) uint32_t name = profile_cycles()
+#define PROFILE_END(id, name) profile_add(id, profile_cycles() - name)
+#else
+#define PROFILE_START(name)
+#define PROFILE_END(id, name)
+#endif
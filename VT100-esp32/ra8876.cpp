@@ -0,0 +1,433 @@
+// RA8876 driver, see ra8876.h
+//
+// Every access is its own chip select: RA8876_CMD_WRITE and a register
+// number selects a register, RA8876_DATA_WRITE and bytes write it (or
+// the memory data port). Register values are remembered so that the
+// setup shared by consecutive BTE operations is only sent once.
+
+#include "ra8876.h"
+#include "tft.h"
+#include "font.h"
+#include "profile.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// text cells. Pixel glyphs are the 5x8 font with blank columns to the
+// right, and every scanline twice in a 16 line cell.
+#define GLYPH_WIDTH RA8876_CHAR_WIDTH
+#define GLYPH_HEIGHT RA8876_CHAR_HEIGHT
+#define GLYPH_SCALE (GLYPH_HEIGHT / 8)
+
+#define RA8876_SCRATCH ((uint32_t)RA8876_LAYERS * RA8876_LAYER_BYTES)
+
+// there is one panel, the terminals (vt100.h) share it
+static struct ra8876 {
+	uint16_t back_color, front_color;
+	uint8_t layer; // drawn and shown
+	uint8_t busy; // an engine operation was started and may still run
+	// value last written to each register, 0xffff when unknown
+	uint16_t regs[256];
+} panel;
+
+// pixel and bitmap data goes straight to the bus where there is no DMA,
+// otherwise it is collected in the transport's line buffers
+#if TFT_DMA
+static struct ra8876_px {
+	uint8_t *buf;
+	uint16_t len;
+} px;
+
+static void _ra8876_pxBegin(void){
+	tft_begin();
+	px.buf = tft_lineBuffer();
+	px.buf[0] = RA8876_DATA_WRITE;
+	px.len = 1;
+}
+
+static inline void _ra8876_pxByte(uint8_t c){
+	px.buf[px.len++] = c;
+	if(px.len == TFT_LINE_BYTES){
+		tft_sendLine(px.len);
+		px.buf = tft_lineBuffer();
+		px.len = 0;
+	}
+}
+
+static void _ra8876_pxEnd(void){
+	if(px.len) tft_sendLine(px.len);
+	tft_end();
+}
+#else
+static void _ra8876_pxBegin(void){
+	tft_begin();
+	tft_write(RA8876_DATA_WRITE);
+}
+#define _ra8876_pxByte tft_write
+#define _ra8876_pxEnd tft_end
+#endif
+
+static void _ra8876_command(uint8_t reg){
+	tft_begin();
+	tft_write(RA8876_CMD_WRITE);
+	tft_write(reg);
+	tft_end();
+}
+
+static void _ra8876_data(uint8_t c){
+	tft_begin();
+	tft_write(RA8876_DATA_WRITE);
+	tft_write(c);
+	tft_end();
+}
+
+static uint8_t _ra8876_status(void){
+	tft_begin();
+	tft_write(RA8876_STATUS_READ);
+	uint8_t s = tft_read();
+	tft_end();
+	return s;
+}
+
+// the engine's registers must not change under a running operation
+static void _ra8876_idle(void){
+	if(!panel.busy) return;
+	PROFILE_START(start);
+	while(_ra8876_status() & RA8876_STATUS_BUSY);
+	PROFILE_END(PROFILE_ENGINE_WAIT, start);
+	panel.busy = 0;
+}
+
+static void _ra8876_reg(uint8_t reg, uint8_t val){
+	if(panel.regs[reg] == val) return;
+	_ra8876_idle();
+	_ra8876_command(reg);
+	_ra8876_data(val);
+	panel.regs[reg] = val;
+}
+
+static void _ra8876_reg16(uint8_t reg, uint16_t val){
+	_ra8876_reg(reg, val);
+	_ra8876_reg(reg + 1, val >> 8);
+}
+
+static void _ra8876_reg32(uint8_t reg, uint32_t val){
+	_ra8876_reg16(reg, val);
+	_ra8876_reg16(reg + 2, val >> 16);
+}
+
+// starts a BTE or geometry operation, always written
+static void _ra8876_start(uint8_t reg, uint8_t val){
+	_ra8876_idle();
+	_ra8876_command(reg);
+	_ra8876_data(val);
+	panel.busy = 1;
+}
+
+static void _ra8876_color(uint8_t reg, uint16_t c){
+	_ra8876_reg(reg, (c >> 8) & 0xf8);
+	_ra8876_reg(reg + 1, (c >> 3) & 0xfc);
+	_ra8876_reg(reg + 2, c << 3);
+}
+
+static uint32_t _ra8876_layerAddr(uint8_t layer){
+	return layer * RA8876_LAYER_BYTES;
+}
+
+static void _ra8876_dest(uint32_t addr, uint16_t x, uint16_t y){
+	_ra8876_reg32(RA8876_DT_STR0, addr);
+	_ra8876_reg16(RA8876_DT_WTH0, RA8876_WIDTH);
+	_ra8876_reg16(RA8876_DT_X0, x);
+	_ra8876_reg16(RA8876_DT_Y0, y);
+}
+
+static void _ra8876_size(uint16_t w, uint16_t h){
+	_ra8876_reg16(RA8876_BTE_WTH0, w);
+	_ra8876_reg16(RA8876_BTE_HIG0, h);
+}
+
+// BTE solid fill
+static void _ra8876_fill(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color){
+	_ra8876_color(RA8876_FGCR, color);
+	_ra8876_dest(_ra8876_layerAddr(panel.layer), x, y);
+	_ra8876_size(w, h);
+	_ra8876_reg(RA8876_BTE_CTRL1, RA8876_BTE_FILL);
+	_ra8876_start(RA8876_BTE_CTRL0, 0x10);
+}
+
+// BTE memory copy between two canvases
+static void _ra8876_copy(uint32_t from, uint16_t x, uint16_t y, uint32_t to, uint16_t dx, uint16_t dy,
+	uint16_t w, uint16_t h){
+	_ra8876_reg32(RA8876_S0_STR0, from);
+	_ra8876_reg16(RA8876_S0_WTH0, RA8876_WIDTH);
+	_ra8876_reg16(RA8876_S0_X0, x);
+	_ra8876_reg16(RA8876_S0_Y0, y);
+	_ra8876_dest(to, dx, dy);
+	_ra8876_size(w, h);
+	_ra8876_reg(RA8876_BTE_CTRL1, RA8876_ROP_S0 | RA8876_BTE_COPY);
+	_ra8876_start(RA8876_BTE_CTRL0, 0x10);
+}
+
+void ra8876_init(void) {
+	tft_init();
+	memset(panel.regs, 0xff, sizeof(panel.regs));
+
+	_ra8876_command(RA8876_SRR);
+	_ra8876_data(0x01);
+	tft_delay(100);
+
+	// 10MHz crystal: 50MHz pixel clock, 100MHz SDRAM and core
+	_ra8876_reg(RA8876_PPLLC1, 0x06);
+	_ra8876_reg(RA8876_PPLLC2, 39);
+	_ra8876_reg(RA8876_MPLLC1, 0x04);
+	_ra8876_reg(RA8876_MPLLC2, 39);
+	_ra8876_reg(RA8876_SPLLC1, 0x04);
+	_ra8876_reg(RA8876_SPLLC2, 39);
+	_ra8876_reg(RA8876_CCR, 0x80); // reconfigure the PLLs
+	tft_delay(1);
+
+	// W9812G6KH, CAS latency 3, 64ms refresh over 4096 rows
+	_ra8876_reg(RA8876_SDRAR, 0x29);
+	_ra8876_reg(RA8876_SDRMD, 0x03);
+	_ra8876_reg16(RA8876_SDR_REF0, 1562);
+	_ra8876_reg(RA8876_SDRCR, 0x01);
+	while(!(_ra8876_status() & RA8876_STATUS_RAM));
+
+	_ra8876_reg(RA8876_CCR, 0x82); // 8 bit host bus, 24 bit panel
+	_ra8876_reg(RA8876_MACR, 0x00); // left to right, top to bottom
+	_ra8876_reg(RA8876_ICR, 0x00); // graphic mode, SDRAM
+	_ra8876_reg(RA8876_MPWCTR, 0x04); // 16 bpp main window
+
+	// panel timing and sync polarity
+	_ra8876_reg(RA8876_DPCR, 0x80);
+	_ra8876_reg(RA8876_PCSR, 0xc0);
+	_ra8876_reg(RA8876_HDWR, RA8876_WIDTH / 8 - 1);
+	_ra8876_reg(RA8876_HDWFTR, RA8876_WIDTH % 8);
+	_ra8876_reg(RA8876_HNDR, 160 / 8 - 1);
+	_ra8876_reg(RA8876_HNDFTR, 0);
+	_ra8876_reg(RA8876_HSTR, 160 / 8 - 1);
+	_ra8876_reg(RA8876_HPWR, 70 / 8 - 1);
+	_ra8876_reg16(RA8876_VDHR0, RA8876_HEIGHT - 1);
+	_ra8876_reg16(RA8876_VNDR0, 23 - 1);
+	_ra8876_reg(RA8876_VSTR, 12 - 1);
+	_ra8876_reg(RA8876_VPWR, 10 - 1);
+
+	// all canvases and the shown window are full panel size
+	_ra8876_reg16(RA8876_MIW0, RA8876_WIDTH);
+	_ra8876_reg16(RA8876_MWULX0, 0);
+	_ra8876_reg16(RA8876_MWULY0, 0);
+	_ra8876_reg16(RA8876_CVS_IMWTH0, RA8876_WIDTH);
+	_ra8876_reg16(RA8876_AWUL_X0, 0);
+	_ra8876_reg16(RA8876_AWUL_Y0, 0);
+	_ra8876_reg16(RA8876_AW_WTH0, RA8876_WIDTH);
+	_ra8876_reg16(RA8876_AW_HT0, RA8876_HEIGHT);
+	_ra8876_reg(RA8876_AW_COLOR, 0x01); // block mode, 16 bpp
+	_ra8876_reg(RA8876_BTE_COLR, 0x25); // 16 bpp sources and destination
+#if RA8876_TEXT
+	_ra8876_reg(RA8876_CCR0, 0x00); // internal CGROM, 8x16, ISO 8859-1
+	_ra8876_reg(RA8876_CCR1, 0x00); // background filled, no enlargement
+	_ra8876_reg(RA8876_FLDR, 0);
+	_ra8876_reg(RA8876_F2FSSR, 0);
+#endif
+
+	panel.back_color = 0x0000;
+	panel.front_color = 0xffff;
+	for(uint8_t l = 0; l < RA8876_LAYERS; l++){
+		panel.layer = l;
+		_ra8876_fill(0, 0, RA8876_WIDTH, RA8876_HEIGHT, 0x0000);
+	}
+	ra8876_setLayer(0);
+
+	_ra8876_reg(RA8876_DPCR, 0xc0); // display on
+
+	// backlight on pwm 0, always high
+	_ra8876_reg(RA8876_PSCLR, 0x00);
+	_ra8876_reg(RA8876_PMUXR, 0x00);
+	_ra8876_reg16(RA8876_TCNTB0L, 100);
+	_ra8876_reg16(RA8876_TCMPB0L, 100);
+	_ra8876_reg(RA8876_PCFGR, 0x03);
+}
+
+void ra8876_setLayer(uint8_t layer){
+	if(layer >= RA8876_LAYERS) return;
+	panel.layer = layer;
+	_ra8876_reg32(RA8876_MISA0, _ra8876_layerAddr(layer));
+	_ra8876_reg32(RA8876_CVSSA0, _ra8876_layerAddr(layer));
+}
+
+// the panel is landscape only, rotation is ignored
+void ra8876_setRotation(uint8_t m) {
+	(void)m;
+}
+
+uint16_t ra8876_width(void){
+	return RA8876_WIDTH;
+}
+
+uint16_t ra8876_height(void){
+	return RA8876_HEIGHT;
+}
+
+void ra8876_setBackColor(uint16_t col){
+	panel.back_color = col;
+}
+
+void ra8876_setFrontColor(uint16_t col){
+	panel.front_color = col;
+}
+
+void ra8876_fillRect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color) {
+	if(x >= RA8876_WIDTH || y >= RA8876_HEIGHT || !w || !h) return;
+	if(x + w > RA8876_WIDTH) w = RA8876_WIDTH - x;
+	if(y + h > RA8876_HEIGHT) h = RA8876_HEIGHT - y;
+	_ra8876_fill(x, y, w, h, color);
+}
+
+void ra8876_drawRect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color, uint16_t backColor) {
+	ra8876_fillRect(x + 1, y + 1, w - 2, h - 2, backColor);
+	ra8876_drawFastVLine(x, y, h, color);
+	ra8876_drawFastVLine(x + (w - 1), y, h, color);
+	ra8876_drawFastHLine(x + 1, y, w - 2, color);
+	ra8876_drawFastHLine(x + 1, y + (h - 1), w - 2, color);
+}
+
+void ra8876_drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+	if(x < 0 || y < 0 || h <= 0) return;
+	ra8876_fillRect(x, y, 1, h, color);
+}
+
+void ra8876_drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+	if(x < 0 || y < 0 || w <= 0) return;
+	ra8876_fillRect(x, y, w, 1, color);
+}
+
+void ra8876_copyRect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t dx, uint16_t dy){
+	if(x + w > RA8876_WIDTH || dx + w > RA8876_WIDTH || y + h > RA8876_HEIGHT || dy + h > RA8876_HEIGHT) return;
+	uint32_t layer = _ra8876_layerAddr(panel.layer);
+
+	// the engine copies line by line from the top, so moving up (scrolling)
+	// is one copy even where the areas overlap. Moving an overlapping area
+	// down would overwrite lines before they are read, that goes through
+	// scratch.
+	uint8_t down = dy > y || (dy == y && dx > x);
+	if(down && x < dx + w && dx < x + w && y < dy + h && dy < y + h){
+		_ra8876_copy(layer, x, y, RA8876_SCRATCH, x, y, w, h);
+		_ra8876_copy(RA8876_SCRATCH, x, y, layer, dx, dy, w, h);
+		return;
+	}
+	_ra8876_copy(layer, x, y, layer, dx, dy, w, h);
+}
+
+void ra8876_drawPixel(int16_t x, int16_t y, uint16_t color) {
+	if(x < 0 || x >= RA8876_WIDTH || y < 0 || y >= RA8876_HEIGHT) return;
+	_ra8876_idle();
+	_ra8876_reg16(RA8876_CURH0, x);
+	_ra8876_reg16(RA8876_CURV0, y);
+	_ra8876_reg(RA8876_ICR, 0x00);
+	// the write moves the graphic cursor on, past the right edge to the
+	// next line
+	for(uint8_t r = RA8876_CURH0; r < RA8876_CURV0 + 2; r++) panel.regs[r] = 0xffff;
+	_ra8876_command(RA8876_MRWDP);
+	_ra8876_pxBegin();
+	_ra8876_pxByte(color);
+	_ra8876_pxByte(color >> 8);
+	_ra8876_pxEnd();
+}
+
+// drawn by the geometry engine
+void ra8876_drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+	if(x0 < 0 || x1 < 0 || y0 < 0 || y1 < 0) return;
+	if(x0 >= RA8876_WIDTH || x1 >= RA8876_WIDTH || y0 >= RA8876_HEIGHT || y1 >= RA8876_HEIGHT) return;
+
+	_ra8876_color(RA8876_FGCR, color);
+	_ra8876_reg16(RA8876_DLHSR0, x0);
+	_ra8876_reg16(RA8876_DLVSR0, y0);
+	_ra8876_reg16(RA8876_DLHER0, x1);
+	_ra8876_reg16(RA8876_DLVER0, y1);
+	_ra8876_start(RA8876_DCR0, 0x80);
+}
+
+void ra8876_drawChar(uint16_t x, uint16_t y, uint8_t ch){
+	ra8876_drawChars(x, y, &ch, 1);
+}
+
+#if !RA8876_TEXT
+// draws a run of characters on one text row as a single BTE colour
+// expansion: each scanline of the run goes over the bus as one bit per
+// pixel, starting on a byte, and the controller paints the 1 bits in the
+// front colour and the 0 bits in the back colour
+static void _ra8876_glyphs(uint16_t x, uint16_t y, const uint8_t *chars, uint8_t count){
+	_ra8876_dest(_ra8876_layerAddr(panel.layer), x, y);
+	_ra8876_size(count * GLYPH_WIDTH, GLYPH_HEIGHT);
+	// start bit 7: the first pixel is the msb of each byte
+	_ra8876_reg(RA8876_BTE_CTRL1, 0x70 | RA8876_BTE_EXPAND);
+	_ra8876_reg(RA8876_ICR, 0x00);
+	_ra8876_start(RA8876_BTE_CTRL0, 0x10);
+	_ra8876_command(RA8876_MRWDP);
+
+	_ra8876_pxBegin();
+	for(uint8_t b = 0; b < GLYPH_HEIGHT; b++){
+		uint16_t bits = 0;
+		uint8_t have = 0;
+		for(uint8_t c = 0; c < count; c++){
+			uint8_t row = pgm_read_byte(&font_rows[chars[c] * 8 + b / GLYPH_SCALE]);
+			bits = (bits << GLYPH_WIDTH) | (row >> (8 - GLYPH_WIDTH));
+			have += GLYPH_WIDTH;
+			if(have >= 8){
+				have -= 8;
+				_ra8876_pxByte(bits >> have);
+			}
+		}
+		if(have) _ra8876_pxByte(bits << (8 - have));
+	}
+	_ra8876_pxEnd();
+}
+#else
+// sends a run of codes to the character generator, which draws them from
+// its ROM at the text cursor and moves the cursor on. The memory write
+// fifo is let drain every RA8876_TEXT_FIFO codes.
+static void _ra8876_text(uint16_t x, uint16_t y, const uint8_t *chars, uint8_t count){
+	_ra8876_idle();
+	_ra8876_reg(RA8876_ICR, RA8876_ICR_TEXT);
+	_ra8876_reg16(RA8876_F_CURX0, x);
+	_ra8876_reg16(RA8876_F_CURY0, y);
+	_ra8876_command(RA8876_MRWDP);
+	for(uint8_t i = 0; i < count; ){
+		if(i){
+			PROFILE_START(start);
+			while(!(_ra8876_status() & RA8876_STATUS_EMPTY));
+			PROFILE_END(PROFILE_ENGINE_WAIT, start);
+		}
+		_ra8876_pxBegin();
+		for(uint8_t n = 0; n < RA8876_TEXT_FIFO && i < count; n++) _ra8876_pxByte(chars[i++]);
+		_ra8876_pxEnd();
+	}
+	panel.busy = 1;
+	// the next run on the row usually starts where this one ended
+	x += count * GLYPH_WIDTH;
+	if(x < RA8876_WIDTH){
+		panel.regs[RA8876_F_CURX0] = x & 0xff;
+		panel.regs[RA8876_F_CURX0 + 1] = x >> 8;
+	} else {
+		for(uint8_t r = RA8876_F_CURX0; r < RA8876_F_CURY0 + 2; r++) panel.regs[r] = 0xffff;
+	}
+}
+#endif
+
+void ra8876_drawChars(uint16_t x, uint16_t y, const uint8_t *chars, uint8_t count){
+	if(x >= RA8876_WIDTH || y + GLYPH_HEIGHT > RA8876_HEIGHT) return;
+	if(x + count * GLYPH_WIDTH > RA8876_WIDTH) count = (RA8876_WIDTH - x) / GLYPH_WIDTH;
+	if(!count) return;
+
+	_ra8876_color(RA8876_FGCR, panel.front_color);
+	_ra8876_color(RA8876_BGCR, panel.back_color);
+#if RA8876_TEXT
+	_ra8876_text(x, y, chars, count);
+#else
+	_ra8876_glyphs(x, y, chars, count);
+#endif
+}
+
+void ra8876_drawString(uint16_t x, uint16_t y, const char *text){
+	ra8876_drawChars(x, y, (const uint8_t *)text, strlen(text));
+}
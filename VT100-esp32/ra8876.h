@@ -0,0 +1,182 @@
+// RA8876 driver for the 1024x600 ER-TFTM070-6
+//
+// Same drawing calls as ili9340.h, but the pixels are moved by the
+// controller: fills, copies and scrolling are Block Transfer Engine (BTE)
+// operations in its SDRAM. Text goes over the bus as character codes for
+// the character generator (RA8876_TEXT), or as one bit per pixel that the
+// BTE expands to the two colours. There is no scroll window like the
+// ILI9340's: the terminal scrolls by moving the rows up with
+// ra8876_copyRect(), one BTE copy, and filling the ones that come free.
+
+#pragma once
+
+#include <stdint.h>
+
+// the ER-TFTM070-6 panel, ra8876_init() has its timings
+#ifndef RA8876_WIDTH
+#define RA8876_WIDTH  1024
+#endif
+#ifndef RA8876_HEIGHT
+#define RA8876_HEIGHT 600
+#endif
+
+// screens kept in SDRAM, ra8876_setLayer() picks the one drawn and shown.
+// One more canvas after them is scratch space for BTE moves.
+#ifndef RA8876_LAYERS
+#define RA8876_LAYERS 2
+#endif
+#define RA8876_LAYER_BYTES ((uint32_t)RA8876_WIDTH * RA8876_HEIGHT * 2)
+
+// text through the character generator: codes go over the bus and the
+// controller draws the glyphs from its internal CGROM in 8x16 cells. The
+// terminal only draws printable ASCII, where the ISO 8859 ROM and the code
+// page 437 font agree. 0 draws pixels in the 6x8 cells of the ILI9340.
+#ifndef RA8876_TEXT
+#define RA8876_TEXT 1
+#endif
+#if RA8876_TEXT
+#define RA8876_CHAR_WIDTH  8
+#define RA8876_CHAR_HEIGHT 16
+#else
+#define RA8876_CHAR_WIDTH  6
+#define RA8876_CHAR_HEIGHT 8
+#endif
+// codes sent before waiting for the memory write fifo to drain
+#ifndef RA8876_TEXT_FIFO
+#define RA8876_TEXT_FIFO 16
+#endif
+
+// the registers used here
+#define RA8876_SRR      0x00 // software reset
+#define RA8876_CCR      0x01 // chip configuration
+#define RA8876_MACR     0x02 // memory access control
+#define RA8876_ICR      0x03 // input control
+#define RA8876_MRWDP    0x04 // memory data port
+#define RA8876_PPLLC1   0x05
+#define RA8876_PPLLC2   0x06
+#define RA8876_MPLLC1   0x07
+#define RA8876_MPLLC2   0x08
+#define RA8876_SPLLC1   0x09
+#define RA8876_SPLLC2   0x0A
+#define RA8876_MPWCTR   0x10 // main window control
+#define RA8876_DPCR     0x12 // display configuration
+#define RA8876_PCSR     0x13 // panel sync polarity
+#define RA8876_HDWR     0x14 // horizontal display width / 8 - 1
+#define RA8876_HDWFTR   0x15
+#define RA8876_HNDR     0x16
+#define RA8876_HNDFTR   0x17
+#define RA8876_HSTR     0x18
+#define RA8876_HPWR     0x19
+#define RA8876_VDHR0    0x1A // vertical display height - 1
+#define RA8876_VNDR0    0x1C
+#define RA8876_VSTR     0x1E
+#define RA8876_VPWR     0x1F
+#define RA8876_MISA0    0x20 // main image start address, 4 bytes
+#define RA8876_MIW0     0x24 // main image width, 2 bytes
+#define RA8876_MWULX0   0x26 // main window upper left x, y, 2 bytes each
+#define RA8876_MWULY0   0x28
+#define RA8876_CVSSA0   0x50 // canvas start address, 4 bytes
+#define RA8876_CVS_IMWTH0 0x54 // canvas width, 2 bytes
+#define RA8876_AWUL_X0  0x56 // active window x, y, width, height
+#define RA8876_AWUL_Y0  0x58
+#define RA8876_AW_WTH0  0x5A
+#define RA8876_AW_HT0   0x5C
+#define RA8876_AW_COLOR 0x5E // canvas addressing and colour depth
+#define RA8876_CURH0    0x5F // graphic write position x, y
+#define RA8876_CURV0    0x61
+#define RA8876_F_CURX0  0x63 // text write position x, y
+#define RA8876_F_CURY0  0x65
+#define RA8876_DCR0     0x67 // draw line / triangle
+#define RA8876_DLHSR0   0x68 // line start x, y and end x, y, 2 bytes each
+#define RA8876_DLVSR0   0x6A
+#define RA8876_DLHER0   0x6C
+#define RA8876_DLVER0   0x6E
+#define RA8876_PSCLR    0x84 // pwm prescaler
+#define RA8876_PMUXR    0x85 // pwm clock mux
+#define RA8876_PCFGR    0x86 // pwm configuration
+#define RA8876_TCMPB0L  0x88 // pwm 0 compare and count, 2 bytes each
+#define RA8876_TCNTB0L  0x8A
+#define RA8876_BTE_CTRL0 0x90
+#define RA8876_BTE_CTRL1 0x91
+#define RA8876_BTE_COLR 0x92
+#define RA8876_S0_STR0  0x93 // source 0 start address, width, x, y
+#define RA8876_S0_WTH0  0x97
+#define RA8876_S0_X0    0x99
+#define RA8876_S0_Y0    0x9B
+#define RA8876_DT_STR0  0xA7 // destination start address, width, x, y
+#define RA8876_DT_WTH0  0xAB
+#define RA8876_DT_X0    0xAD
+#define RA8876_DT_Y0    0xAF
+#define RA8876_BTE_WTH0 0xB1 // size of the operation
+#define RA8876_BTE_HIG0 0xB3
+#define RA8876_CCR0     0xCC // character source, size and ROM code page
+#define RA8876_CCR1     0xCD // character background, rotation, enlargement
+#define RA8876_FLDR     0xD0 // gap between text lines
+#define RA8876_F2FSSR   0xD1 // gap between characters
+#define RA8876_FGCR     0xD2 // foreground red, green, blue
+#define RA8876_BGCR     0xD5 // background red, green, blue
+#define RA8876_SDRAR    0xE0 // SDRAM attributes
+#define RA8876_SDRMD    0xE1
+#define RA8876_SDR_REF0 0xE2
+#define RA8876_SDRCR    0xE4
+
+// the first byte of every chip select says what follows
+#define RA8876_CMD_WRITE    0x00
+#define RA8876_STATUS_READ  0x40
+#define RA8876_DATA_WRITE   0x80
+#define RA8876_DATA_READ    0xC0
+
+// status register bits
+#define RA8876_STATUS_EMPTY 0x40 // memory write fifo empty
+#define RA8876_STATUS_BUSY  0x08 // BTE, geometry or text engine running
+#define RA8876_STATUS_RAM   0x04 // SDRAM ready
+
+// ICR: the memory data port takes character codes instead of pixels
+#define RA8876_ICR_TEXT     0x04
+
+// BTE_CTRL1: ROP (or colour expansion start bit) in the top nibble,
+// operation in the bottom one
+#define RA8876_BTE_COPY     0x02
+#define RA8876_BTE_EXPAND   0x08
+#define RA8876_BTE_FILL     0x0C
+#define RA8876_ROP_S0       0xC0
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void ra8876_init(void);
+void ra8876_drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+void ra8876_drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+void ra8876_setRotation(uint8_t m);
+void ra8876_drawString(uint16_t x, uint16_t y, const char *text);
+void ra8876_drawChar(uint16_t x, uint16_t y, uint8_t c);
+void ra8876_drawChars(uint16_t x, uint16_t y, const uint8_t *chars, uint8_t count);
+void ra8876_setBackColor(uint16_t col);
+void ra8876_setFrontColor(uint16_t col);
+void ra8876_drawRect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color, uint16_t backColor);
+void ra8876_fillRect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color);
+void ra8876_drawPixel(int16_t x, int16_t y, uint16_t color);
+void ra8876_drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color);
+
+// copies w x h pixels at (x, y) to (dx, dy), the areas may overlap
+void ra8876_copyRect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t dx, uint16_t dy);
+// draws on and shows layer 0 .. RA8876_LAYERS - 1. Each layer keeps its
+// own contents.
+void ra8876_setLayer(uint8_t layer);
+
+uint16_t ra8876_width(void);
+uint16_t ra8876_height(void);
+
+#if defined(VT100_HOST)
+// register level stand-in for the controller (ra8876_host.cpp) that the
+// host transport feeds when VT100_RA8876 is defined
+void ra8876_hostSelect(void);
+void ra8876_hostWrite(uint8_t c);
+uint8_t ra8876_hostRead(void);
+uint16_t ra8876_hostPixel(uint16_t x, uint16_t y);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,244 @@
+// Host stand-in for the RA8876: takes the bytes the driver sends over SPI
+// and acts on them like the controller would, with its SDRAM in memory.
+// Only what ra8876.cpp uses is modelled - register writes, the memory
+// data port with the graphic cursor, BTE fill, copy and colour expansion,
+// line drawing, 8x16 text from the character generator and the main
+// window. Operations finish at once, so the busy bit never shows.
+// It is written from the datasheet next to the driver, so the RA8876
+// goldens show the two agree, not that the chip would draw the same.
+
+#if defined(VT100_HOST)
+
+#include <string.h>
+
+#include "ra8876.h"
+#include "font.h"
+
+#define RA8876_PIXELS ((uint32_t)(RA8876_LAYERS + 1) * RA8876_WIDTH * RA8876_HEIGHT)
+
+static struct ra8876_host {
+	uint8_t regs[256];
+	uint8_t cycle; // first byte of this chip select, 0xff until it came
+	uint8_t reg; // register the last command write selected
+	uint8_t lo, have_lo; // first byte of a pixel
+	uint16_t cur_x, cur_y; // graphic cursor
+	uint16_t text_x, text_y; // text cursor
+	// colour expansion waiting for data: pixels written of the current
+	// line and lines done
+	uint8_t expanding;
+	uint16_t exp_x, exp_y;
+} ra;
+
+static uint16_t sdram[RA8876_PIXELS];
+
+static uint16_t _ra8876_r16(uint8_t reg){
+	return ra.regs[reg] | (ra.regs[reg + 1] << 8);
+}
+
+static uint32_t _ra8876_r32(uint8_t reg){
+	return _ra8876_r16(reg) | ((uint32_t)_ra8876_r16(reg + 2) << 16);
+}
+
+// the position registers follow the cursors as they move on
+static void _ra8876_w16(uint8_t reg, uint16_t val){
+	ra.regs[reg] = val;
+	ra.regs[reg + 1] = val >> 8;
+}
+
+static uint16_t _ra8876_rgb(uint8_t reg){
+	return ((ra.regs[reg] & 0xf8) << 8) | ((ra.regs[reg + 1] & 0xfc) << 3) | (ra.regs[reg + 2] >> 3);
+}
+
+// pixel (x, y) of the canvas starting at byte address addr
+static void _ra8876_put(uint32_t addr, uint16_t width, uint16_t x, uint16_t y, uint16_t color){
+	uint32_t i = addr / 2 + (uint32_t)y * width + x;
+	if(x < width && i < RA8876_PIXELS) sdram[i] = color;
+}
+
+static uint16_t _ra8876_get(uint32_t addr, uint16_t width, uint16_t x, uint16_t y){
+	uint32_t i = addr / 2 + (uint32_t)y * width + x;
+	return (x < width && i < RA8876_PIXELS)?sdram[i]:0;
+}
+
+static void _ra8876_bte(void){
+	uint16_t w = _ra8876_r16(RA8876_BTE_WTH0), h = _ra8876_r16(RA8876_BTE_HIG0);
+	uint32_t dt = _ra8876_r32(RA8876_DT_STR0), s0 = _ra8876_r32(RA8876_S0_STR0);
+	uint16_t dw = _ra8876_r16(RA8876_DT_WTH0), sw = _ra8876_r16(RA8876_S0_WTH0);
+	uint16_t dx = _ra8876_r16(RA8876_DT_X0), dy = _ra8876_r16(RA8876_DT_Y0);
+	uint16_t sx = _ra8876_r16(RA8876_S0_X0), sy = _ra8876_r16(RA8876_S0_Y0);
+
+	switch(ra.regs[RA8876_BTE_CTRL1] & 0x0f){
+		case RA8876_BTE_FILL:
+			for(uint16_t y = 0; y < h; y++)
+				for(uint16_t x = 0; x < w; x++) _ra8876_put(dt, dw, dx + x, dy + y, _ra8876_rgb(RA8876_FGCR));
+			break;
+		case RA8876_BTE_COPY:
+			// line by line from the top, like the engine
+			for(uint16_t y = 0; y < h; y++)
+				for(uint16_t x = 0; x < w; x++)
+					_ra8876_put(dt, dw, dx + x, dy + y, _ra8876_get(s0, sw, sx + x, sy + y));
+			break;
+		case RA8876_BTE_EXPAND:
+			ra.expanding = w && h;
+			ra.exp_x = ra.exp_y = 0;
+			break;
+	}
+}
+
+// one byte of colour expansion data, msb first. A line always starts on
+// a new byte.
+static void _ra8876_expand(uint8_t c){
+	uint16_t w = _ra8876_r16(RA8876_BTE_WTH0), h = _ra8876_r16(RA8876_BTE_HIG0);
+	uint32_t dt = _ra8876_r32(RA8876_DT_STR0);
+	uint16_t dw = _ra8876_r16(RA8876_DT_WTH0);
+	uint16_t dx = _ra8876_r16(RA8876_DT_X0), dy = _ra8876_r16(RA8876_DT_Y0);
+
+	for(uint8_t bit = 0x80; bit && ra.exp_x < w; bit >>= 1, ra.exp_x++){
+		uint16_t color = (c & bit)?_ra8876_rgb(RA8876_FGCR):_ra8876_rgb(RA8876_BGCR);
+		_ra8876_put(dt, dw, dx + ra.exp_x, dy + ra.exp_y, color);
+	}
+	if(ra.exp_x >= w){
+		ra.exp_x = 0;
+		if(++ra.exp_y >= h) ra.expanding = 0;
+	}
+}
+
+static void _ra8876_line(void){
+	int16_t x0 = _ra8876_r16(RA8876_DLHSR0), y0 = _ra8876_r16(RA8876_DLVSR0);
+	int16_t x1 = _ra8876_r16(RA8876_DLHER0), y1 = _ra8876_r16(RA8876_DLVER0);
+	int16_t dx = (x1 > x0)?x1 - x0:x0 - x1, dy = (y1 > y0)?y0 - y1:y1 - y0;
+	int16_t sx = (x0 < x1)?1:-1, sy = (y0 < y1)?1:-1, err = dx + dy;
+	uint32_t canvas = _ra8876_r32(RA8876_CVSSA0);
+	uint16_t width = _ra8876_r16(RA8876_CVS_IMWTH0);
+	while(1){
+		_ra8876_put(canvas, width, x0, y0, _ra8876_rgb(RA8876_FGCR));
+		if(x0 == x1 && y0 == y1) break;
+		int16_t e2 = 2 * err;
+		if(e2 >= dy){ err += dy; x0 += sx; }
+		if(e2 <= dx){ err += dx; y0 += sy; }
+	}
+	ra.regs[RA8876_DCR0] &= ~0x80;
+}
+
+// a pixel through the memory data port at the graphic cursor, which moves
+// on inside the active window
+static void _ra8876_pixel(uint16_t color){
+	_ra8876_put(_ra8876_r32(RA8876_CVSSA0), _ra8876_r16(RA8876_CVS_IMWTH0), ra.cur_x, ra.cur_y, color);
+	uint16_t left = _ra8876_r16(RA8876_AWUL_X0), top = _ra8876_r16(RA8876_AWUL_Y0);
+	if(++ra.cur_x >= left + _ra8876_r16(RA8876_AW_WTH0)){
+		ra.cur_x = left;
+		if(++ra.cur_y >= top + _ra8876_r16(RA8876_AW_HT0)) ra.cur_y = top;
+	}
+	_ra8876_w16(RA8876_CURH0, ra.cur_x);
+	_ra8876_w16(RA8876_CURV0, ra.cur_y);
+}
+
+// a character code in text mode, drawn at the text cursor which moves on
+// inside the active window. The real CGROM glyphs are not reproduced: the
+// ROM here is the terminal font on every other scanline, with the lines
+// in between in the background colour. Pixel glyphs (RA8876_TEXT 0) are
+// the same font with every scanline doubled, so a screenshot or golden
+// hash shows which path drew each cell.
+static void _ra8876_char(uint8_t c){
+	uint32_t canvas = _ra8876_r32(RA8876_CVSSA0);
+	uint16_t width = _ra8876_r16(RA8876_CVS_IMWTH0);
+	uint8_t opaque = !(ra.regs[RA8876_CCR1] & 0x40);
+	for(uint8_t y = 0; y < 16; y++){
+		uint8_t row = (y & 1)?0:font_rows[c * 8 + y / 2];
+		for(uint8_t x = 0; x < 8; x++){
+			if(row & (0x80 >> x))
+				_ra8876_put(canvas, width, ra.text_x + x, ra.text_y + y, _ra8876_rgb(RA8876_FGCR));
+			else if(opaque)
+				_ra8876_put(canvas, width, ra.text_x + x, ra.text_y + y, _ra8876_rgb(RA8876_BGCR));
+		}
+	}
+	uint16_t left = _ra8876_r16(RA8876_AWUL_X0);
+	ra.text_x += 8 + ra.regs[RA8876_F2FSSR];
+	if(ra.text_x + 8 > left + _ra8876_r16(RA8876_AW_WTH0)){
+		ra.text_x = left;
+		ra.text_y += 16 + ra.regs[RA8876_FLDR];
+	}
+	_ra8876_w16(RA8876_F_CURX0, ra.text_x);
+	_ra8876_w16(RA8876_F_CURY0, ra.text_y);
+}
+
+static void _ra8876_write(uint8_t c){
+	if(ra.reg == RA8876_MRWDP){
+		if(ra.regs[RA8876_ICR] & RA8876_ICR_TEXT){
+			_ra8876_char(c);
+		} else if(ra.expanding){
+			_ra8876_expand(c);
+		} else if(!ra.have_lo){
+			ra.lo = c;
+			ra.have_lo = 1;
+		} else {
+			ra.have_lo = 0;
+			_ra8876_pixel((c << 8) | ra.lo);
+		}
+		return;
+	}
+	ra.regs[ra.reg] = c;
+	switch(ra.reg){
+		case RA8876_SRR:
+			if(c & 1) memset(ra.regs, 0, sizeof(ra.regs));
+			break;
+		case RA8876_CURH0: case RA8876_CURH0 + 1:
+			ra.cur_x = _ra8876_r16(RA8876_CURH0);
+			break;
+		case RA8876_CURV0: case RA8876_CURV0 + 1:
+			ra.cur_y = _ra8876_r16(RA8876_CURV0);
+			break;
+		case RA8876_F_CURX0: case RA8876_F_CURX0 + 1:
+			ra.text_x = _ra8876_r16(RA8876_F_CURX0);
+			break;
+		case RA8876_F_CURY0: case RA8876_F_CURY0 + 1:
+			ra.text_y = _ra8876_r16(RA8876_F_CURY0);
+			break;
+		case RA8876_BTE_CTRL0:
+			if(c & 0x10) _ra8876_bte();
+			ra.regs[RA8876_BTE_CTRL0] &= ~0x10;
+			break;
+		case RA8876_DCR0:
+			if(c & 0x80) _ra8876_line();
+			break;
+	}
+}
+
+void ra8876_hostSelect(void){
+	ra.cycle = 0xff;
+}
+
+void ra8876_hostWrite(uint8_t c){
+	if(ra.cycle == 0xff){
+		ra.cycle = c;
+		return;
+	}
+	switch(ra.cycle){
+		case RA8876_CMD_WRITE:
+			ra.reg = c;
+			ra.have_lo = 0;
+			break;
+		case RA8876_DATA_WRITE:
+			_ra8876_write(c);
+			break;
+	}
+}
+
+uint8_t ra8876_hostRead(void){
+	switch(ra.cycle){
+		case RA8876_STATUS_READ:
+			// write fifo and read fifo empty, SDRAM ready, never busy
+			return 0x40 | 0x10 | RA8876_STATUS_RAM;
+		case RA8876_DATA_READ:
+			return ra.regs[ra.reg];
+	}
+	return 0xff;
+}
+
+// what the main window shows
+uint16_t ra8876_hostPixel(uint16_t x, uint16_t y){
+	return _ra8876_get(_ra8876_r32(RA8876_MISA0), _ra8876_r16(RA8876_MIW0),
+		x + _ra8876_r16(RA8876_MWULX0), y + _ra8876_r16(RA8876_MWULY0));
+}
+
+#endif
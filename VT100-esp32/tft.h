@@ -0,0 +1,108 @@
+// Transport between the ILI9340 driver and the panel
+//
+// ili9340.cpp only talks to the controller through these calls. Each
+// platform provides them in its own tft_*.cpp (all files are compiled,
+// each one builds to nothing on the wrong platform):
+//
+//   tft_avr.cpp      ATmega hardware SPI, pins on PORTB
+//   tft_esp32.cpp    ESP32 VSPI through the SPI library
+//   tft_teensy4.cpp  Teensy 4 LPSPI through the SPI library
+//   tft_host.cpp     no panel, the ILI9340 is emulated into a frame buffer
+//                    (build with VT100_HOST defined), or the RA8876 by
+//                    ra8876_host.cpp
+
+#pragma once
+
+#include <stdint.h>
+
+#include "profile.h"
+
+#if defined(__AVR__) && !defined(VT100_HOST)
+#include <avr/io.h>
+// no DMA on the ATmega SPI, pixels are written a byte at a time
+#define TFT_DMA 0
+#else
+#define TFT_DMA 1
+#endif
+
+// size of each of the two pixel line buffers. They are 32 bit aligned and
+// this must be a multiple of 4.
+#ifndef TFT_LINE_BYTES
+#define TFT_LINE_BYTES 512
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// sets up the bus and pins and pulses the panel's reset line
+void tft_init(void);
+void tft_delay(uint16_t ms);
+
+// sends one command byte and leaves the panel selected with DC set for
+// data, so parameters and further commands can follow without tft_begin()
+void tft_command(uint8_t c);
+
+// a run of data (parameter or pixel) bytes. tft_end() deselects the panel,
+// tft_begin() always starts a new chip select (the RA8876 takes the first
+// byte after it as the kind of access).
+void tft_begin(void);
+void tft_end(void);
+
+#if defined(__AVR__) && !defined(VT100_HOST)
+// every pixel goes through here so it is inlined on the slow part
+static inline void tft_write(uint8_t c){
+	SPDR = c;
+	PROFILE_START(start);
+	while(!(SPSR & _BV(SPIF)));
+	PROFILE_END(PROFILE_TFT_WAIT, start);
+}
+// the ATmega SPI only moves bytes
+static inline void tft_write16(uint16_t c){
+	tft_write(c >> 8);
+	tft_write(c);
+}
+static inline uint8_t tft_read(void){
+	tft_write(0);
+	return SPDR;
+}
+#else
+void tft_write(uint8_t c);
+// a big endian 16 bit parameter in one transfer
+void tft_write16(uint16_t c);
+// clocks in one byte (status reads)
+uint8_t tft_read(void);
+#endif
+
+#if TFT_DMA
+// pixel data is staged in two line buffers: while one is clocked out by
+// DMA the other is filled. tft_lineBuffer() returns the free one (waiting
+// for it if both are busy) and tft_sendLine() queues len bytes of it and
+// returns at once. tft_end() does not wait either - tft_begin(),
+// tft_command(), tft_write() and tft_read() wait for everything queued to
+// be sent.
+uint8_t *tft_lineBuffer(void);
+void tft_sendLine(uint16_t len);
+#endif
+
+#if defined(VT100_HOST)
+// what the panel shows at (x, y) in its natural orientation (portrait for
+// the ILI9340, landscape for the RA8876), vertical scrolling included
+uint16_t tft_hostPixel(uint16_t x, uint16_t y);
+// writes the panel as a binary PPM image, returns 0 on failure
+int tft_hostSavePPM(const char *path);
+// 32 bit FNV-1a hash of what the panel shows, row by row, for comparing
+// screens without keeping them. The second one only hashes w x h pixels
+// at (x, y), e.g. one terminal's viewport.
+uint32_t tft_hostHash(void);
+uint32_t tft_hostHashRect(uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+// bytes and commands (chip selects on the RA8876) sent since start
+uint32_t tft_hostBytes(void);
+uint32_t tft_hostCommands(void);
+// line buffers found changed between tft_sendLine() and being sent
+uint32_t tft_hostDmaErrors(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,90 @@
+// ATmega1284 hardware SPI transport for the ILI9340
+
+#if defined(__AVR__) && !defined(VT100_HOST)
+
+#include <avr/io.h>
+#include <util/delay.h>
+
+#include "tft.h"
+
+// on 1284 reset to chip reset, sdk to 7,  miso not connected
+// mosi to 5, dc to 2, CS to 1
+
+#define SPI_DDR DDRB
+#define SPI_PORT PORTB
+#define SPI_MISO PB6
+#define SPI_MOSI PB5
+#define SPI_SCK PB7
+#define SPI_SS PB4
+
+#define ILI_PORT PORTB
+#define ILI_DDR DDRB
+#define CS_PIN PB1
+#define RST_PIN 0
+#define DC_PIN PB2
+
+#define _SB(port, pin) {port |= _BV(pin);}
+#define _RB(port, pin) {port &= ~_BV(pin);}
+#define CS_HI _SB(ILI_PORT, CS_PIN)
+#define CS_LO _RB(ILI_PORT, CS_PIN)
+#define RST_HI _SB(ILI_PORT, RST_PIN)
+#define RST_LO _RB(ILI_PORT, RST_PIN)
+#define DC_HI _SB(ILI_PORT, DC_PIN)
+#define DC_LO _RB(ILI_PORT, DC_PIN)
+
+static void _spi_init(void) {
+    SPI_DDR &= ~((1<<SPI_MISO)); //input
+    SPI_DDR |= ((1<<SPI_MOSI) | (1<<SPI_SS) | (1<<SPI_SCK)); //output
+
+		// pullup!
+		SPI_PORT |= (1<<SPI_MISO);
+
+    SPCR = ((1<<SPE)|               // SPI Enable
+            (0<<SPIE)|              // SPI Interupt Enable
+            (0<<DORD)|              // Data Order (0:MSB first / 1:LSB first)
+            (1<<MSTR)|              // Master/Slave select
+            (0<<SPR1)|(0<<SPR0)|    // SPI Clock Rate
+            (0<<CPOL)|              // Clock Polarity (0:SCK low / 1:SCK hi when idle)
+            (0<<CPHA));             // Clock Phase (0:leading / 1:trailing edge sampling)
+
+    SPSR = (1<<SPI2X); // Double SPI Speed Bit
+}
+
+void tft_init(void){
+	ILI_DDR |= _BV(RST_PIN);
+	ILI_DDR |= _BV(DC_PIN);
+	ILI_DDR |= _BV(CS_PIN);
+
+	RST_LO;
+
+	_spi_init();
+
+	RST_HI;
+	_delay_ms(5);
+	RST_LO;
+	_delay_ms(20);
+	RST_HI;
+	_delay_ms(150);
+}
+
+void tft_delay(uint16_t ms){
+	while(ms--) _delay_ms(1);
+}
+
+void tft_command(uint8_t c){
+	DC_LO;
+	CS_LO;
+	tft_write(c);
+	DC_HI;
+}
+
+void tft_begin(void){
+	DC_HI;
+	CS_LO;
+}
+
+void tft_end(void){
+	CS_HI;
+}
+
+#endif
@@ -0,0 +1,183 @@
+// ESP32 VSPI transport for the ILI9340
+
+#if defined(ESP32) && !defined(VT100_HOST)
+
+#include <Arduino.h>
+#include <string.h>
+#include <driver/spi_master.h>
+
+#include "tft.h"
+#include "profile.h"
+#include "uart.h"
+
+#ifndef TFT_SCK
+#define TFT_SCK 18
+#endif
+#ifndef TFT_MOSI
+#define TFT_MOSI 23
+#endif
+#ifndef TFT_MISO
+#define TFT_MISO 19
+#endif
+#ifndef TFT_CS
+#define TFT_CS 5
+#endif
+#ifndef TFT_DC
+#define TFT_DC 2
+#endif
+#ifndef TFT_RST
+#define TFT_RST 22
+#endif
+#ifndef TFT_SPI_HZ
+#define TFT_SPI_HZ 40000000
+#endif
+
+// RTS/CTS flow control would reset the panel every time it holds the host off
+#if TFT_RST == UART_RTS_PIN
+#error TFT_RST and UART_RTS_PIN are the same pin
+#endif
+
+static struct tft_spi {
+	spi_device_handle_t dev;
+	// line buffers and the transactions sending them, see tft_lineBuffer()
+	spi_transaction_t trans[2];
+	uint8_t next; // buffer handed out by tft_lineBuffer()
+	uint8_t queued; // transactions not yet collected
+	uint8_t release_cs; // tft_end() came while transfers were running
+} tft;
+
+static DMA_ATTR uint8_t lines[2][TFT_LINE_BYTES];
+
+// collects finished transactions until nothing is left on the bus
+static void _tft_wait(void){
+	spi_transaction_t *done;
+	if(tft.queued){
+		PROFILE_START(start);
+		while(tft.queued){
+			spi_device_get_trans_result(tft.dev, &done, portMAX_DELAY);
+			tft.queued--;
+		}
+		PROFILE_END(PROFILE_TFT_WAIT, start);
+	}
+	if(tft.release_cs){
+		digitalWrite(TFT_CS, HIGH);
+		tft.release_cs = 0;
+	}
+}
+
+// one byte without DMA, used for commands and parameters
+static void _tft_byte(uint8_t c){
+	spi_transaction_t t;
+	memset(&t, 0, sizeof(t));
+	t.flags = SPI_TRANS_USE_TXDATA;
+	t.length = 8;
+	t.tx_data[0] = c;
+	spi_device_polling_transmit(tft.dev, &t);
+}
+
+void tft_init(void){
+	pinMode(TFT_CS, OUTPUT);
+	pinMode(TFT_DC, OUTPUT);
+	pinMode(TFT_RST, OUTPUT);
+	digitalWrite(TFT_CS, HIGH);
+
+	spi_bus_config_t bus;
+	memset(&bus, 0, sizeof(bus));
+	bus.mosi_io_num = TFT_MOSI;
+	bus.miso_io_num = TFT_MISO;
+	bus.sclk_io_num = TFT_SCK;
+	bus.quadwp_io_num = -1;
+	bus.quadhd_io_num = -1;
+	bus.max_transfer_sz = TFT_LINE_BYTES;
+	spi_bus_initialize(VSPI_HOST, &bus, 1);
+
+	// CS and DC are driven by hand since DC changes inside a transfer
+	spi_device_interface_config_t dev;
+	memset(&dev, 0, sizeof(dev));
+	dev.clock_speed_hz = TFT_SPI_HZ;
+	dev.mode = 0;
+	dev.spics_io_num = -1;
+	dev.queue_size = 2;
+	spi_bus_add_device(VSPI_HOST, &dev, &tft.dev);
+
+	digitalWrite(TFT_RST, HIGH);
+	delay(5);
+	digitalWrite(TFT_RST, LOW);
+	delay(20);
+	digitalWrite(TFT_RST, HIGH);
+	delay(150);
+}
+
+void tft_delay(uint16_t ms){
+	delay(ms);
+}
+
+void tft_command(uint8_t c){
+	_tft_wait();
+	digitalWrite(TFT_DC, LOW);
+	digitalWrite(TFT_CS, LOW);
+	_tft_byte(c);
+	digitalWrite(TFT_DC, HIGH);
+}
+
+void tft_begin(void){
+	_tft_wait();
+	digitalWrite(TFT_DC, HIGH);
+	digitalWrite(TFT_CS, LOW);
+}
+
+void tft_end(void){
+	if(tft.queued) tft.release_cs = 1;
+	else digitalWrite(TFT_CS, HIGH);
+}
+
+void tft_write(uint8_t c){
+	_tft_wait();
+	_tft_byte(c);
+}
+
+void tft_write16(uint16_t c){
+	spi_transaction_t t;
+	_tft_wait();
+	memset(&t, 0, sizeof(t));
+	t.flags = SPI_TRANS_USE_TXDATA;
+	t.length = 16;
+	t.tx_data[0] = c >> 8;
+	t.tx_data[1] = c;
+	spi_device_polling_transmit(tft.dev, &t);
+}
+
+uint8_t tft_read(void){
+	spi_transaction_t t;
+	_tft_wait();
+	memset(&t, 0, sizeof(t));
+	t.flags = SPI_TRANS_USE_TXDATA | SPI_TRANS_USE_RXDATA;
+	t.length = 8;
+	spi_device_polling_transmit(tft.dev, &t);
+	return t.rx_data[0];
+}
+
+uint8_t *tft_lineBuffer(void){
+	// both in flight - transactions finish in order so the first one
+	// collected is the buffer handed out next
+	if(tft.queued == 2){
+		spi_transaction_t *done;
+		PROFILE_START(start);
+		spi_device_get_trans_result(tft.dev, &done, portMAX_DELAY);
+		PROFILE_END(PROFILE_TFT_WAIT, start);
+		tft.queued--;
+	}
+	return lines[tft.next];
+}
+
+void tft_sendLine(uint16_t len){
+	spi_transaction_t *t = &tft.trans[tft.next];
+	memset(t, 0, sizeof(*t));
+	t->length = len * 8;
+	t->tx_buffer = lines[tft.next];
+	spi_device_queue_trans(tft.dev, t, portMAX_DELAY);
+	tft.queued++;
+	tft.next ^= 1;
+}
+
+#endif
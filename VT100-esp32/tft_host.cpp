@@ -0,0 +1,277 @@
+// Host transport: emulates the ILI9340 into an in-memory frame buffer so
+// the terminal can run (and be looked at) without a panel. With
+// VT100_RA8876 the bytes go to the RA8876 model in ra8876_host.cpp
+// instead.
+
+#if defined(VT100_HOST)
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tft.h"
+#include "display.h"
+#include "profile.h"
+
+// simulated DMA: up to two queued line buffers that only reach the panel
+// when the driver has to wait for them, like a transfer that is still
+// running in the background
+static struct tft_dma {
+	uint8_t lines[2][TFT_LINE_BYTES] __attribute__((aligned(4)));
+	uint8_t next; // buffer handed out by tft_lineBuffer()
+	uint8_t queued; // buffers in flight, the oldest is lines[(next + queued) & 1]
+	uint16_t len[2];
+	uint32_t sum[2]; // contents when queued
+	uint32_t errors;
+} dma;
+
+// what went over the bus
+static struct tft_bus {
+	uint32_t bytes, commands;
+} bus;
+
+// drawing calls made through display.h
+uint32_t display_calls;
+
+#if defined(VT100_RA8876)
+#define TFT_HOST_WIDTH RA8876_WIDTH
+#define TFT_HOST_HEIGHT RA8876_HEIGHT
+#define _tft_param ra8876_hostWrite
+#else
+#define TFT_HOST_WIDTH ILI9340_TFTWIDTH
+#define TFT_HOST_HEIGHT ILI9340_TFTHEIGHT
+
+static struct tft_host {
+	// display ram as the controller holds it, 240 columns of 320 lines
+	uint16_t gram[ILI9340_TFTHEIGHT][ILI9340_TFTWIDTH];
+	uint8_t cmd; // last command, its parameters are collected in args
+	uint8_t nargs; uint8_t args[6];
+	uint8_t madctl;
+	// address window and write position, in rotated (MADCTL) coordinates
+	uint16_t x0, x1, y0, y1, x, y;
+	uint8_t hi, have_hi; // first byte of a pixel
+	// vertical scroll definition (0x33) and start (0x37)
+	uint16_t tfa, vsa, bfa, vsp;
+} tft = {
+	{{0}}, 0, 0, {0}, 0,
+	0, ILI9340_TFTWIDTH - 1, 0, ILI9340_TFTHEIGHT - 1, 0, 0,
+	0, 0,
+	0, ILI9340_TFTHEIGHT, 0, 0
+};
+
+// stores a pixel the way the controller would with the current MADCTL
+static void _tft_pixel(uint16_t x, uint16_t y, uint16_t color){
+	uint16_t col = x, line = y;
+	if(tft.madctl & ILI9340_MADCTL_MV){ col = y; line = x; }
+	if(col >= ILI9340_TFTWIDTH || line >= ILI9340_TFTHEIGHT) return;
+	if(tft.madctl & ILI9340_MADCTL_MX) col = ILI9340_TFTWIDTH - 1 - col;
+	if(tft.madctl & ILI9340_MADCTL_MY) line = ILI9340_TFTHEIGHT - 1 - line;
+	tft.gram[line][col] = color;
+}
+
+static void _tft_param(uint8_t c){
+	if(tft.nargs < sizeof(tft.args)) tft.args[tft.nargs++] = c;
+	uint16_t a = (tft.args[0] << 8) | tft.args[1];
+	uint16_t b = (tft.args[2] << 8) | tft.args[3];
+	switch(tft.cmd){
+		case ILI9340_CASET:
+			if(tft.nargs == 4){ tft.x0 = a; tft.x1 = b; }
+			break;
+		case ILI9340_PASET:
+			if(tft.nargs == 4){ tft.y0 = a; tft.y1 = b; }
+			break;
+		case ILI9340_MADCTL:
+			tft.madctl = c;
+			break;
+		case 0x33: // vertical scroll definition
+			if(tft.nargs == 6){
+				tft.tfa = a; tft.vsa = b;
+				tft.bfa = (tft.args[4] << 8) | tft.args[5];
+			}
+			break;
+		case 0x37: // vertical scroll start
+			if(tft.nargs == 2) tft.vsp = a;
+			break;
+		case ILI9340_RAMWR:
+			if(!tft.have_hi){
+				tft.hi = c;
+				tft.have_hi = 1;
+				break;
+			}
+			tft.have_hi = 0;
+			_tft_pixel(tft.x, tft.y, (tft.hi << 8) | c);
+			if(++tft.x > tft.x1){
+				tft.x = tft.x0;
+				if(++tft.y > tft.y1) tft.y = tft.y0;
+			}
+			break;
+	}
+}
+
+// display ram line shown on panel line y
+static uint16_t _tft_line(uint16_t y){
+	if(y < tft.tfa || y >= tft.tfa + tft.vsa || !tft.vsa) return y;
+	uint16_t line = tft.vsp + (y - tft.tfa);
+	while(line >= tft.tfa + tft.vsa) line -= tft.vsa;
+	return line;
+}
+#endif
+
+static uint32_t _tft_sum(const uint8_t *buf, uint16_t len){
+	uint32_t h = 2166136261u;
+	while(len--) h = (h ^ *buf++) * 16777619u;
+	return h;
+}
+
+// the oldest queued buffer goes out
+static void _tft_complete(void){
+	uint8_t i = (dma.next + dma.queued) & 1;
+	if(_tft_sum(dma.lines[i], dma.len[i]) != dma.sum[i]) dma.errors++;
+	for(uint16_t n = 0; n < dma.len[i]; n++){
+		bus.bytes++;
+		_tft_param(dma.lines[i][n]);
+	}
+	dma.queued--;
+}
+
+static void _tft_wait(void){
+	if(dma.queued){
+		PROFILE_START(start);
+		while(dma.queued) _tft_complete();
+		PROFILE_END(PROFILE_TFT_WAIT, start);
+	}
+}
+
+uint8_t *tft_lineBuffer(void){
+	// both buffers in flight - the one handed out next is the oldest
+	if(dma.queued == 2){
+		PROFILE_START(start);
+		_tft_complete();
+		PROFILE_END(PROFILE_TFT_WAIT, start);
+	}
+	return dma.lines[dma.next];
+}
+
+void tft_sendLine(uint16_t len){
+	dma.len[dma.next] = len;
+	dma.sum[dma.next] = _tft_sum(dma.lines[dma.next], len);
+	dma.queued++;
+	dma.next ^= 1;
+}
+
+void tft_init(void){
+}
+
+void tft_delay(uint16_t ms){
+	(void)ms;
+}
+
+void tft_command(uint8_t c){
+	_tft_wait();
+	bus.bytes++;
+	bus.commands++;
+#if !defined(VT100_RA8876)
+	tft.cmd = c;
+	tft.nargs = 0;
+	if(c == ILI9340_RAMWR){
+		tft.x = tft.x0;
+		tft.y = tft.y0;
+		tft.have_hi = 0;
+	}
+#else
+	(void)c;
+#endif
+}
+
+void tft_begin(void){
+	_tft_wait();
+#if defined(VT100_RA8876)
+	// every access is a chip select of its own there
+	bus.commands++;
+	ra8876_hostSelect();
+#endif
+}
+
+// like the real transports the data may still be on its way when a
+// drawing call returns
+void tft_end(void){
+}
+
+void tft_write(uint8_t c){
+	_tft_wait();
+	bus.bytes++;
+	_tft_param(c);
+}
+
+uint8_t tft_read(void){
+	_tft_wait();
+	bus.bytes++;
+#if defined(VT100_RA8876)
+	return ra8876_hostRead();
+#else
+	return 0; // MISO is not connected
+#endif
+}
+
+void tft_write16(uint16_t c){
+	tft_write(c >> 8);
+	tft_write(c);
+}
+
+uint16_t tft_hostPixel(uint16_t x, uint16_t y){
+	_tft_wait();
+	if(x >= TFT_HOST_WIDTH || y >= TFT_HOST_HEIGHT) return 0;
+#if defined(VT100_RA8876)
+	return ra8876_hostPixel(x, y);
+#else
+	// the panel scans columns from the right, MX undoes that
+	return tft.gram[_tft_line(y)][ILI9340_TFTWIDTH - 1 - x];
+#endif
+}
+
+int tft_hostSavePPM(const char *path){
+	FILE *f = fopen(path, "wb");
+	if(!f) return 0;
+	fprintf(f, "P6 %d %d 255\n", TFT_HOST_WIDTH, TFT_HOST_HEIGHT);
+	for(uint16_t y = 0; y < TFT_HOST_HEIGHT; y++){
+		for(uint16_t x = 0; x < TFT_HOST_WIDTH; x++){
+			uint16_t p = tft_hostPixel(x, y);
+			uint8_t rgb[3] = {
+				(uint8_t)((p >> 11) << 3), (uint8_t)(((p >> 5) & 0x3f) << 2), (uint8_t)((p & 0x1f) << 3)
+			};
+			fwrite(rgb, 1, 3, f);
+		}
+	}
+	fclose(f);
+	return 1;
+}
+
+uint32_t tft_hostHash(void){
+	return tft_hostHashRect(0, 0, TFT_HOST_WIDTH, TFT_HOST_HEIGHT);
+}
+
+uint32_t tft_hostHashRect(uint16_t x0, uint16_t y0, uint16_t w, uint16_t h){
+	uint32_t hash = 2166136261UL;
+	for(uint16_t y = y0; y < y0 + h; y++){
+		for(uint16_t x = x0; x < x0 + w; x++){
+			uint16_t p = tft_hostPixel(x, y);
+			hash = (hash ^ (p >> 8)) * 16777619UL;
+			hash = (hash ^ (p & 0xff)) * 16777619UL;
+		}
+	}
+	return hash;
+}
+
+uint32_t tft_hostBytes(void){
+	_tft_wait();
+	return bus.bytes;
+}
+
+uint32_t tft_hostCommands(void){
+	return bus.commands;
+}
+
+uint32_t tft_hostDmaErrors(void){
+	return dma.errors;
+}
+
+#endif
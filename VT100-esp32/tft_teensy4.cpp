@@ -0,0 +1,132 @@
+// Teensy 4 LPSPI4 transport for the ILI9340
+
+#if defined(__IMXRT1062__) && !defined(VT100_HOST)
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <EventResponder.h>
+
+#include "tft.h"
+#include "profile.h"
+#include "uart.h"
+
+// SPI (LPSPI4) pins are sck 13, miso 12, mosi 11
+#ifndef TFT_CS
+#define TFT_CS 10
+#endif
+#ifndef TFT_DC
+#define TFT_DC 9
+#endif
+#ifndef TFT_RST
+#define TFT_RST 8
+#endif
+#ifndef TFT_SPI_HZ
+#define TFT_SPI_HZ 30000000
+#endif
+
+// RTS/CTS flow control would reset the panel every time it holds the host off
+#if TFT_RST == UART_RTS_PIN
+#error TFT_RST and UART_RTS_PIN are the same pin
+#endif
+
+static struct tft_spi {
+	EventResponder done;
+	volatile uint8_t busy; // a line buffer is being sent
+	uint8_t next; // buffer handed out by tft_lineBuffer()
+	uint8_t release_cs; // tft_end() came while a transfer was running
+} tft;
+
+// the SPI library runs one DMA transfer at a time, so while it sends one
+// buffer the other is free to fill
+static uint8_t lines[2][TFT_LINE_BYTES] __attribute__((aligned(4)));
+
+static void _tft_done(EventResponderRef){
+	tft.busy = 0;
+}
+
+static void _tft_wait(void){
+	if(tft.busy){
+		PROFILE_START(start);
+		while(tft.busy);
+		PROFILE_END(PROFILE_TFT_WAIT, start);
+	}
+	if(tft.release_cs){
+		digitalWriteFast(TFT_CS, HIGH);
+		tft.release_cs = 0;
+	}
+}
+
+void tft_init(void){
+	pinMode(TFT_CS, OUTPUT);
+	pinMode(TFT_DC, OUTPUT);
+	pinMode(TFT_RST, OUTPUT);
+	digitalWriteFast(TFT_CS, HIGH);
+
+	SPI.begin();
+	// the panel is the only device on the bus so the transaction stays open
+	SPI.beginTransaction(SPISettings(TFT_SPI_HZ, MSBFIRST, SPI_MODE0));
+	tft.done.attachImmediate(_tft_done);
+
+	digitalWriteFast(TFT_RST, HIGH);
+	delay(5);
+	digitalWriteFast(TFT_RST, LOW);
+	delay(20);
+	digitalWriteFast(TFT_RST, HIGH);
+	delay(150);
+}
+
+void tft_delay(uint16_t ms){
+	delay(ms);
+}
+
+void tft_command(uint8_t c){
+	_tft_wait();
+	digitalWriteFast(TFT_DC, LOW);
+	digitalWriteFast(TFT_CS, LOW);
+	SPI.transfer(c);
+	digitalWriteFast(TFT_DC, HIGH);
+}
+
+void tft_begin(void){
+	_tft_wait();
+	digitalWriteFast(TFT_DC, HIGH);
+	digitalWriteFast(TFT_CS, LOW);
+}
+
+void tft_end(void){
+	if(tft.busy) tft.release_cs = 1;
+	else digitalWriteFast(TFT_CS, HIGH);
+}
+
+void tft_write(uint8_t c){
+	_tft_wait();
+	SPI.transfer(c);
+}
+
+void tft_write16(uint16_t c){
+	_tft_wait();
+	SPI.transfer16(c);
+}
+
+uint8_t tft_read(void){
+	_tft_wait();
+	return SPI.transfer(0);
+}
+
+uint8_t *tft_lineBuffer(void){
+	return lines[tft.next];
+}
+
+void tft_sendLine(uint16_t len){
+	// the previous buffer has to be out before this one can start
+	if(tft.busy){
+		PROFILE_START(start);
+		while(tft.busy);
+		PROFILE_END(PROFILE_TFT_WAIT, start);
+	}
+	tft.busy = 1;
+	SPI.transfer(lines[tft.next], NULL, len, tft.done);
+	tft.next ^= 1;
+}
+
+#endif
@@ -0,0 +1,304 @@
+// Receive ring for the host UART (Serial1)
+
+#include <arduino.h>
+#include <string.h>
+#if defined(__AVR__)
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+// 16 and 32 bit values shared with the interrupt can't be accessed in one go
+#define UART_ATOMIC ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+// the interrupt can't run in the middle of the loop's UART_ATOMIC, so the
+// ring indices need nothing more
+#define UART_LOAD(v) (v)
+#define UART_STORE(v, x) ((v) = (x))
+#else
+#if defined(ESP32)
+// the receive callback runs in a task of its own, maybe on the other core
+static portMUX_TYPE uart_mux = portMUX_INITIALIZER_UNLOCKED;
+static inline uint8_t _uart_lock(void){
+	portENTER_CRITICAL(&uart_mux);
+	return 1;
+}
+static inline uint8_t _uart_unlock(void){
+	portEXIT_CRITICAL(&uart_mux);
+	return 0;
+}
+#define UART_ATOMIC for(uint8_t _uart_once = _uart_lock(); _uart_once; _uart_once = _uart_unlock())
+#else
+// the ring is only filled from uart_poll(), in the loop itself
+#define UART_ATOMIC
+#endif
+// a side publishes its index once the bytes it covers are in place (or
+// read), the other side sees them before it sees the index
+#define UART_LOAD(v) __atomic_load_n(&(v), __ATOMIC_ACQUIRE)
+#define UART_STORE(v, x) __atomic_store_n(&(v), (x), __ATOMIC_RELEASE)
+#endif
+
+#include "uart.h"
+
+#define RX_MASK (UART_RX_SIZE - 1)
+
+static struct uart {
+	uint8_t buf[UART_RX_SIZE];
+	// head is only written by the receive interrupt, tail only by the loop,
+	// each with UART_STORE() and read by the other side with UART_LOAD()
+	volatile uint16_t head, tail;
+	// most bytes ever waiting in the ring
+	volatile uint16_t high_water;
+	// bytes lost because the ring (or the UART itself) was full
+	volatile uint32_t overruns;
+	// one byte at a time is timed on its way to the panel, the first one
+	// to come in after the last was handed on (see uart_rxStamp())
+	volatile uint8_t stamped;
+	volatile uint16_t stamp_pos;
+	volatile uint32_t stamp_us;
+#if defined(ESP32)
+	// set while the receive callback or uart_poll() moves bytes in
+	uint8_t filling;
+#endif
+} rx;
+
+static struct uart_flow {
+	uint8_t mode;
+	// ring fill levels to hold off and release the host at
+	uint16_t high, low;
+	volatile uint8_t stopped;
+} flow = { UART_FLOW_NONE, UART_RX_HIGH_WATER, UART_RX_LOW_WATER, 0 };
+
+static void _uart_txByte(uint8_t c);
+
+static void _uart_signal(uint8_t mode, uint8_t stop){
+	if(mode == UART_FLOW_XONXOFF)
+		_uart_txByte(stop ? UART_XOFF : UART_XON);
+	else if(mode == UART_FLOW_RTSCTS)
+		digitalWrite(UART_RTS_PIN, stop ? HIGH : LOW);
+}
+
+// tells the host to stop (or start) sending. The change is decided under
+// UART_ATOMIC and sent after it, as the ESP32 core can't write to the
+// port in a critical section. Both the receive side and the loop get
+// here, so the sender checks afterwards that its change still stands and
+// sends the state again if the other side changed it meanwhile.
+static void _uart_throttle(uint8_t stop){
+	uint8_t mode, send;
+	UART_ATOMIC {
+		send = flow.stopped != stop;
+		flow.stopped = stop;
+		mode = flow.mode;
+	}
+	while(send){
+		_uart_signal(mode, stop);
+		UART_ATOMIC {
+			send = flow.stopped != stop || flow.mode != mode;
+			stop = flow.stopped;
+			mode = flow.mode;
+		}
+	}
+}
+
+static inline void _uart_rxPut(uint8_t c){
+	uint16_t head = rx.head;
+	uint16_t next = (head + 1) & RX_MASK;
+	uint16_t tail = UART_LOAD(rx.tail);
+	if(next == tail){
+		rx.overruns++;
+		return;
+	}
+	rx.buf[head] = c;
+	if(!UART_LOAD(rx.stamped)){
+		rx.stamp_us = micros();
+		rx.stamp_pos = head;
+		UART_STORE(rx.stamped, 1);
+	}
+	UART_STORE(rx.head, next);
+
+	uint16_t used = (next - tail) & RX_MASK;
+	if(used > rx.high_water) rx.high_water = used;
+	if(used >= flow.high && flow.mode != UART_FLOW_NONE && !flow.stopped) _uart_throttle(1);
+}
+
+// whether the ring takes another byte. Where the core buffers the port
+// what doesn't fit is left there, so the core's buffer adds to the ring
+// and flow control, already on by then, holds the host off.
+static inline uint8_t _uart_rxRoom(void){
+	return ((rx.head + 1) & RX_MASK) != UART_LOAD(rx.tail);
+}
+
+#if defined(__AVR__)
+
+// we own USART1 so HardwareSerial's Serial1 must not be used anywhere
+ISR(USART1_RX_vect){
+	uint8_t status = UCSR1A;
+	uint8_t c = UDR1;
+	if(status & _BV(DOR1)) rx.overruns++;
+	_uart_rxPut(c);
+}
+
+void uart_begin(uint32_t baud){
+	UCSR1B = 0;
+	UCSR1A = _BV(U2X1);
+	UBRR1 = (F_CPU + baud * 4) / (baud * 8) - 1;
+	UCSR1C = _BV(UCSZ11) | _BV(UCSZ10); // 8N1
+	UCSR1B = _BV(RXEN1) | _BV(TXEN1) | _BV(RXCIE1);
+}
+
+void uart_poll(void){
+}
+
+// only flow control goes out here so the transmitter is never busy for
+// longer than one character
+static void _uart_txByte(uint8_t c){
+	while(!(UCSR1A & _BV(UDRE1)));
+	UDR1 = c;
+}
+
+size_t uart_txWrite(const uint8_t *data, size_t len){
+	size_t n = 0;
+	// the receive interrupt could slip an XOFF in between test and write
+	UART_ATOMIC {
+		while(n < len && (UCSR1A & _BV(UDRE1))) UDR1 = data[n++];
+	}
+	return n;
+}
+
+#elif defined(ESP32)
+
+// moves the driver buffer into the ring while it has room. The core's
+// receive callback does it as bytes come in and uart_poll() picks up what
+// was left for want of room; whichever comes second leaves it to the
+// other, so the ring still has a single producer.
+static void _uart_drain(void){
+	if(__atomic_exchange_n(&rx.filling, 1, __ATOMIC_ACQUIRE)) return;
+	while(_uart_rxRoom() && Serial1.available()) _uart_rxPut(Serial1.read());
+	__atomic_store_n(&rx.filling, 0, __ATOMIC_RELEASE);
+}
+
+static void _uart_onReceive(void){
+	_uart_drain();
+}
+
+void uart_begin(uint32_t baud){
+	Serial1.end();
+	Serial1.begin(baud);
+	Serial1.onReceive(_uart_onReceive);
+}
+
+void uart_poll(void){
+	_uart_drain();
+}
+
+static void _uart_txByte(uint8_t c){
+	Serial1.write(c);
+}
+
+size_t uart_txWrite(const uint8_t *data, size_t len){
+	int room = Serial1.availableForWrite();
+	if((int)len > room) len = room;
+	return len?Serial1.write(data, len):0;
+}
+
+#else
+
+// no hook into the receive interrupt - the core's own interrupt buffer
+// is moved into the ring every time round the loop
+void uart_begin(uint32_t baud){
+	Serial1.end();
+	Serial1.begin(baud);
+}
+
+void uart_poll(void){
+	int c;
+	while(_uart_rxRoom() && (c = Serial1.read()) != -1) _uart_rxPut(c);
+}
+
+static void _uart_txByte(uint8_t c){
+	Serial1.write(c);
+}
+
+size_t uart_txWrite(const uint8_t *data, size_t len){
+	int room = Serial1.availableForWrite();
+	if((int)len > room) len = room;
+	return len?Serial1.write(data, len):0;
+}
+
+#endif
+
+static inline uint16_t _uart_head(void){
+	uint16_t head;
+	UART_ATOMIC { head = UART_LOAD(rx.head); }
+	return head;
+}
+
+// returns how many bytes can be read from *data in one piece
+size_t uart_rxChunk(const uint8_t **data){
+	uint16_t head = _uart_head();
+	uint16_t tail = rx.tail;
+	*data = &rx.buf[tail];
+	if(head >= tail) return head - tail;
+	// wrapped - the rest comes with the next chunk
+	return UART_RX_SIZE - tail;
+}
+
+void uart_rxConsume(size_t len){
+	uint16_t tail = (rx.tail + len) & RX_MASK;
+	uint8_t release;
+	UART_ATOMIC {
+		UART_STORE(rx.tail, tail);
+		release = flow.stopped && ((UART_LOAD(rx.head) - tail) & RX_MASK) <= flow.low;
+	}
+	if(release) _uart_throttle(0);
+}
+
+uint8_t uart_rxStamp(size_t len, uint32_t *us){
+	uint8_t found = 0;
+	UART_ATOMIC {
+		if(UART_LOAD(rx.stamped) && ((rx.stamp_pos - rx.tail) & RX_MASK) < len){
+			*us = rx.stamp_us;
+			UART_STORE(rx.stamped, 0);
+			found = 1;
+		}
+	}
+	return found;
+}
+
+void uart_setFlowControl(uint8_t mode){
+	if(mode == UART_FLOW_RTSCTS){
+		digitalWrite(UART_RTS_PIN, LOW);
+		pinMode(UART_RTS_PIN, OUTPUT);
+	}
+	uint8_t old, stopped;
+	UART_ATOMIC {
+		old = flow.mode;
+		stopped = flow.stopped;
+		flow.mode = mode;
+		flow.stopped = 0;
+	}
+	// release the host the old way
+	if(stopped) _uart_signal(old, 0);
+}
+
+void uart_setWatermarks(uint16_t high, uint16_t low){
+	if(high >= UART_RX_SIZE) high = UART_RX_SIZE - 1;
+	if(low >= high) low = high / 2;
+	UART_ATOMIC {
+		flow.high = high;
+		flow.low = low;
+	}
+}
+
+uint16_t uart_rxUsed(void){
+	return (_uart_head() - rx.tail) & RX_MASK;
+}
+
+uint16_t uart_rxHighWater(void){
+	uint16_t high_water;
+	UART_ATOMIC { high_water = rx.high_water; }
+	return high_water;
+}
+
+uint32_t uart_rxOverruns(void){
+	uint32_t overruns;
+	UART_ATOMIC { overruns = rx.overruns; }
+	return overruns;
+}
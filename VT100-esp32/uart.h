@@ -0,0 +1,62 @@
+// Receive ring for the host UART (Serial1)
+//
+// Bytes are put into the ring straight from the UART receive interrupt
+// (or the core's receive callback where we can't own the interrupt) and
+// the main loop hands them to the parser in contiguous chunks.
+//
+// With flow control on, the host is sent XOFF (or RTS is raised) once the
+// ring fills past the high watermark and released again when the loop has
+// drained it below the low one.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// size of the receive ring, must be a power of two
+#ifndef UART_RX_SIZE
+#define UART_RX_SIZE 1024
+#endif
+
+// fill levels at which the host is told to stop and to carry on sending.
+// Leave room above the high mark for what the host still has in flight.
+#ifndef UART_RX_HIGH_WATER
+#define UART_RX_HIGH_WATER (UART_RX_SIZE * 3 / 4)
+#endif
+#ifndef UART_RX_LOW_WATER
+#define UART_RX_LOW_WATER (UART_RX_SIZE / 4)
+#endif
+
+// output pin wired to the host's CTS, low = ok to send
+#ifndef UART_RTS_PIN
+#define UART_RTS_PIN 4
+#endif
+
+// flow control modes
+#define UART_FLOW_NONE 0
+#define UART_FLOW_XONXOFF 1
+#define UART_FLOW_RTSCTS 2
+
+#define UART_XON 0x11
+#define UART_XOFF 0x13
+
+void uart_begin(uint32_t baud);
+void uart_poll(void);
+
+size_t uart_rxChunk(const uint8_t **data);
+void uart_rxConsume(size_t len);
+// if the timed byte is among the next len bytes, which are about to be
+// consumed, gives the micros() it arrived at and returns 1. The next byte
+// to come in is timed after that. Where the core buffers the port
+// (uart_poll()) the time is when the byte was moved into the ring.
+uint8_t uart_rxStamp(size_t len, uint32_t *us);
+uint16_t uart_rxUsed(void);
+// sends as much of data as the transmitter takes without waiting and
+// returns how many bytes that was
+size_t uart_txWrite(const uint8_t *data, size_t len);
+
+void uart_setFlowControl(uint8_t mode);
+void uart_setWatermarks(uint16_t high, uint16_t low);
+
+uint16_t uart_rxHighWater(void);
+uint32_t uart_rxOverruns(void);
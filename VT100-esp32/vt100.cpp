@@ -1,939 +1,1688 @@
-/**
-	This file is part of FORTMAX.
-
-	FORTMAX is free software: you can redistribute it and/or modify
-	it under the terms of the GNU General Public License as published by
-	the Free Software Foundation, either version 3 of the License, or
-	(at your option) any later version.
-
-	FORTMAX is distributed in the hope that it will be useful,
-	but WITHOUT ANY WARRANTY; without even the implied warranty of
-	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-	GNU General Public License for more details.
-
-	You should have received a copy of the GNU General Public License
-	along with FORTMAX.  If not, see <http://www.gnu.org/licenses/>.
-
-	Copyright: Martin K. Schröder (info@fortmax.se) 2014
-*/
-
-#include <avr/io.h>
-#include <ctype.h>
-#include <math.h>
-#include <arduino.h>
-#include <string.h>
-#include <stdarg.h>
-#include <ctype.h>
-#include "vt100.h"
-#include <EEPROM.h>
-
-#include "vt100.h"
-#include "ili9340.h"
-
-char new_br[8];
-
-#define KEY_ESC 0x1b
-#define KEY_DEL 0x7f
-#define KEY_BELL 0x07
-
-#define STATE(NAME, TERM, EV, ARG) void NAME(struct vt100 *TERM, uint8_t EV, uint16_t ARG)
-
-// states 
-enum {
-	STATE_IDLE,
-	STATE_ESCAPE,
-	STATE_COMMAND
-};
-
-// events that are passed into states
-enum {
-	EV_CHAR = 1,
-};
-
-#define MAX_COMMAND_ARGS 4
-static struct vt100 {
-	union flags {
-		uint8_t val;
-    		struct {
-    			// 0 = cursor remains on last column when it gets there
-    			// 1 = lines wrap after last column to next line
-    			uint8_t cursor_wrap : 1; 
-    			uint8_t scroll_mode : 1;
-    			uint8_t origin_mode : 1; 
-    		  }; 
-	      } flags;
-	
-	//uint16_t screen_width, screen_height;
-	// cursor position on the screen (0, 0) = top left corner. 
-	int16_t cursor_x, cursor_y;
-	int16_t saved_cursor_x, saved_cursor_y; // used for cursor save restore
-	int16_t scroll_start_row, scroll_end_row; 
-	// character width and height
-	int8_t char_width, char_height;
-	// colors used for rendering current characters
-	uint16_t back_color, front_color;
-  int16_t saved_back_color, saved_front_color; // used for cursor save restore 7 and 8 - added ps
-	// the starting y-position of the screen scroll
-	uint16_t scroll_value; 
-	// command arguments that get parsed as they appear in the terminal
-	uint8_t narg; uint16_t args[MAX_COMMAND_ARGS];
-	// current arg pointer (we use it for parsing) 
-	uint8_t carg;
-	
-	void (*state)(struct vt100 *term, uint8_t ev, uint16_t arg);
-	void (*send_response)(char *str);
-	void (*ret_state)(struct vt100 *term, uint8_t ev, uint16_t arg); 
-} term;
-
-STATE(_st_idle, term, ev, arg);
-STATE(_st_esc_sq_bracket, term, ev, arg);
-STATE(_st_esc_question, term, ev, arg);
-STATE(_st_esc_hash, term, ev, arg);
-
-void _vt100_reset(void){
-	//term.screen_width = VT100_SCREEN_WIDTH;
-  //term.screen_height = VT100_SCREEN_HEIGHT;
-  term.char_height = VT100_CHAR_HEIGHT;
-  term.char_width = VT100_CHAR_WIDTH;
-  term.back_color = 0x0000;
-  term.front_color = 0xffff;
-  term.cursor_x = term.cursor_y = term.saved_cursor_x = term.saved_cursor_y = 0;
-  term.narg = 0;
-  term.state = _st_idle;
-  term.ret_state = 0;
-  term.scroll_value = 0; 
-  term.scroll_start_row = 0;
-  term.scroll_end_row = VT100_HEIGHT; // outside of screen = whole screen scrollable
-  term.flags.cursor_wrap = 0;
-  term.flags.origin_mode = 0; 
-  ili9340_setFrontColor(term.front_color);
-	ili9340_setBackColor(term.back_color);
-	ili9340_setScrollMargins(0, 0); 
-	ili9340_setScrollStart(0); 
-}
-
-void _vt100_resetScroll(void){
-	term.scroll_start_row = 0;
-	term.scroll_end_row = VT100_HEIGHT;
-	term.scroll_value = 0; 
-	ili9340_setScrollMargins(0, 0);
-	ili9340_setScrollStart(0); 
-}
-
-#define VT100_CURSOR_X(TERM) (TERM->cursor_x * TERM->char_width)
-
-inline uint16_t VT100_CURSOR_Y(struct vt100 *t){
-	// if within the top or bottom margin areas then normal addressing
-	if(t->cursor_y < t->scroll_start_row || t->cursor_y >= t->scroll_end_row){
-		return t->cursor_y * VT100_CHAR_HEIGHT; 
-	} else {
-		// otherwise we are inside scroll area
-		uint16_t scroll_height = t->scroll_end_row - t->scroll_start_row;
-		uint16_t row = t->cursor_y + t->scroll_value; 
-		if(t->cursor_y + t->scroll_value >= t->scroll_end_row)
-			row -= scroll_height; 
-		// if scroll_value == 0: y = t->cursor_y;
-		// if scroll_value == 1 && scroll_start_row == 2 && scroll_end_row == 38:
-		// 		y = t->cursor_y + scroll_value; 
-		//uint16_t row = (t->cursor_y - t->scroll_start_row) % scroll_height; 
-		/*uint16_t skip = t->scroll_value - t->scroll_start_row; 
-		uint16_t row = t->cursor_y + skip;
-		uint16_t scroll_height = t->scroll_end_row - t->scroll_start_row; 
-		//row = (row % scroll_height);// + t->scroll_start_row;*/
-		return row * VT100_CHAR_HEIGHT; 
-	}
-	/*uint16_t y = 0;
-	if(t->cursor_y >= t->top_margin && t->cursor_y < t->bottom_margin){
-		y = t->cursor_y * VT100_CHAR_HEIGHT;
-		if(t->scroll >= (t->top_margin * VT100_CHAR_HEIGHT)){
-			y += t->scroll - t->top_margin * VT100_CHAR_HEIGHT;
-		}
-	} else if(t->cursor_y < t->top_margin){
-		y = (t->cursor_y * VT100_CHAR_HEIGHT);
-	} else if(t->cursor_y >= t->bottom_margin){
-		y = (t->cursor_y * VT100_CHAR_HEIGHT);
-		if(t->scroll >= (t->top_margin * VT100_CHAR_HEIGHT)){
-			y += t->scroll - t->top_margin * VT100_CHAR_HEIGHT;
-		}
-	}
-	//y = ((t->cursor_y - (VT100_HEIGHT - t->bottom_margin)) * VT100_CHAR_HEIGHT);// % VT100_SCREEN_HEIGHT;
-	//y = ((t->cursor_y * VT100_CHAR_HEIGHT) + t->scroll) % VT100_SCREEN_HEIGHT; 
-	return y % VT100_SCREEN_HEIGHT;*/
-}
-
-void _vt100_clearLines(struct vt100 *t, uint16_t start_line, uint16_t end_line){
-	for(int c = start_line; c <= end_line; c++){
-		uint16_t cy = t->cursor_y;
-		t->cursor_y = c; 
-		ili9340_fillRect(0, VT100_CURSOR_Y(t), VT100_SCREEN_WIDTH, VT100_CHAR_HEIGHT, 0x0000);
-		t->cursor_y = cy;
-	}
-	/*uint16_t start = ((start_line * t->char_height) + t->scroll) % VT100_SCREEN_HEIGHT;
-	uint16_t h = (end_line - start_line) * VT100_CHAR_HEIGHT;
-	ili9340_fillRect(0, start, VT100_SCREEN_WIDTH, h, 0x0000); */
-}
-
-// scrolls the scroll region up (lines > 0) or down (lines < 0)
-void _vt100_scroll(struct vt100 *t, int16_t lines){
-	if(!lines) return;
-
-	// get height of scroll area in rows
-	uint16_t scroll_height = t->scroll_end_row - t->scroll_start_row; 
-	// clearing of lines that we have scrolled up or down
-	if(lines > 0){
-		_vt100_clearLines(t, t->scroll_start_row, t->scroll_start_row+lines-1); 
-		// update the scroll value (wraps around scroll_height)
-		t->scroll_value = (t->scroll_value + lines) % scroll_height;
-		// scrolling up so clear first line of scroll area
-		//uint16_t y = (t->scroll_start_row + t->scroll_value) * VT100_CHAR_HEIGHT; 
-		//ili9340_fillRect(0, y, VT100_SCREEN_WIDTH, lines * VT100_CHAR_HEIGHT, 0x0000);
-	} else if(lines < 0){
-		_vt100_clearLines(t, t->scroll_end_row - lines, t->scroll_end_row - 1); 
-		// make sure that the value wraps down 
-		t->scroll_value = (scroll_height + t->scroll_value + lines) % scroll_height; 
-		// scrolling down - so clear last line of the scroll area
-		//uint16_t y = (t->scroll_start_row + t->scroll_value) * VT100_CHAR_HEIGHT; 
-		//ili9340_fillRect(0, y, VT100_SCREEN_WIDTH, lines * VT100_CHAR_HEIGHT, 0x0000);
-	}
-	uint16_t scroll_start = (t->scroll_start_row + t->scroll_value) * VT100_CHAR_HEIGHT; 
-	ili9340_setScrollStart(scroll_start); 
-	
-	/*
-	int16_t pixels = lines * VT100_CHAR_HEIGHT;
-	uint16_t scroll_min = t->top_margin * VT100_CHAR_HEIGHT;
-	uint16_t scroll_max = t->bottom_margin * VT100_CHAR_HEIGHT;
-
-	// starting position must be between top and bottom margin
-	// scroll_start == top margin - no scroll at all
-	if(t->scroll >= scroll_min){
-		// clear the top n lines
-		ili9340_fillRect(0, t->scroll, VT100_SCREEN_WIDTH, pixels, 0x0000); 
-		t->scroll += pixels;
-	} else {
-		ili9340_fillRect(0, scroll_min, VT100_SCREEN_WIDTH, pixels, 0x0000); 
-		t->scroll = scroll_min + pixels;
-	}
-	t->scroll = t->scroll % VT100_SCREEN_HEIGHT; 
-	ili9340_setScrollStart(t->scroll);*/
-}
-
-// moves the cursor relative to current cursor position and scrolls the screen
-void _vt100_move(struct vt100 *term, int16_t right_left, int16_t bottom_top){
-	// calculate how many lines we need to move down or up if x movement goes outside screen
-	int16_t new_x = right_left + term->cursor_x; 
-	if(new_x > VT100_WIDTH){
-		if(term->flags.cursor_wrap){
-			bottom_top += new_x / VT100_WIDTH;
-			term->cursor_x = new_x % VT100_WIDTH - 1;
-		} else {
-			term->cursor_x = VT100_WIDTH;
-		}
-	} else if(new_x < 0){
-		bottom_top += new_x / VT100_WIDTH - 1;
-		term->cursor_x = VT100_WIDTH - (abs(new_x) % VT100_WIDTH) + 1; 
-	} else {
-		term->cursor_x = new_x;
-	}
-
-	if(bottom_top){
-		int16_t new_y = term->cursor_y + bottom_top;
-		int16_t to_scroll = 0;
-		// bottom margin 39 marks last line as static on 40 line display
-		// therefore, we would scroll when new cursor has moved to line 39
-		// (or we could use new_y > VT100_HEIGHT here
-		// NOTE: new_y >= term->scroll_end_row ## to_scroll = (new_y - term->scroll_end_row) +1
-		if(new_y >= term->scroll_end_row){
-			//scroll = new_y / VT100_HEIGHT;
-			//term->cursor_y = VT100_HEIGHT;
-			to_scroll = (new_y - term->scroll_end_row) + 1; 
-			// place cursor back within the scroll region
-			term->cursor_y = term->scroll_end_row - 1; //new_y - to_scroll; 
-			//scroll = new_y - term->bottom_margin; 
-			//term->cursor_y = term->bottom_margin; 
-		} else if(new_y < term->scroll_start_row){
-			to_scroll = (new_y - term->scroll_start_row); 
-			term->cursor_y = term->scroll_start_row; //new_y - to_scroll; 
-			//scroll = new_y / (term->bottom_margin - term->top_margin) - 1;
-			//term->cursor_y = term->top_margin; 
-		} else {
-			// otherwise we move as normal inside the screen
-			term->cursor_y = new_y;
-		}
-		_vt100_scroll(term, to_scroll);
-	}
-}
-
-void _vt100_drawCursor(struct vt100 *t){
-	//uint16_t x = t->cursor_x * t->char_width;
-	//uint16_t y = t->cursor_y * t->char_height;
-
-	//ili9340_fillRect(x, y, t->char_width, t->char_height, t->front_color); 
-}
-
-// sends the character to the display and updates cursor position
-void _vt100_putc(struct vt100 *t, uint8_t ch){
-	if(ch < 0x20 || ch > 0x7e){
-		static const char hex[] = "0123456789abcdef"; 
-		_vt100_putc(t, '0'); 
-		_vt100_putc(t, 'x'); 
-		_vt100_putc(t, hex[((ch & 0xf0) >> 4)]);
-		_vt100_putc(t, hex[(ch & 0x0f)]);
-		return;
-	}
-	
-	// calculate current cursor position in the display ram
-	uint16_t x = VT100_CURSOR_X(t);
-	uint16_t y = VT100_CURSOR_Y(t);
-
-	ili9340_setFrontColor(t->front_color);
-	ili9340_setBackColor(t->back_color); 
-	ili9340_drawChar(x, y, ch);
-
-	// move cursor right
-	_vt100_move(t, 1, 0); 
-	_vt100_drawCursor(t); 
-}
-
-void vt100_puts(const char *str){
-	while(*str){
-		vt100_putc(*str++);
-	}
-}
-
-STATE(_st_command_arg, term, ev, arg){
-	switch(ev){
-		case EV_CHAR: {
-			if(isdigit(arg)){ // a digit argument
-				term->args[term->narg] = term->args[term->narg] * 10 + (arg - '0');
-			} else if(arg == ';') { // separator
-				term->narg++;
-			} else { // no more arguments
-				// go back to command state 
-				term->narg++;
-				if(term->ret_state){
-					term->state = term->ret_state;
-				}
-				else {
-					term->state = _st_idle;
-				}
-				// execute next state as well because we have already consumed a char!
-				term->state(term, ev, arg);
-			}
-			break;
-		}
-	}
-}
-
-STATE(_st_esc_sq_bracket, term, ev, arg){
-	switch(ev){
-		case EV_CHAR: {
-			if(isdigit(arg)){ // start of an argument
-				term->ret_state = _st_esc_sq_bracket; 
-				_st_command_arg(term, ev, arg);
-				term->state = _st_command_arg;
-			} else if(arg == ';'){ // arg separator. 
-				// skip. And also stay in the command state
-			} else { // otherwise we execute the command and go back to idle
-				switch(arg){
-					case 'A': {// move cursor up (cursor stops at top margin)
-						int n = (term->narg > 0)?term->args[0]:1;
-						term->cursor_y -= n;
-						if(term->cursor_y < 0) term->cursor_y = 0; 
-						term->state = _st_idle; 
-						break;
-					} 
-					case 'B': { // cursor down (cursor stops at bottom margin)
-						int n = (term->narg > 0)?term->args[0]:1;
-						term->cursor_y += n;
-						if(term->cursor_y > VT100_HEIGHT) term->cursor_y = VT100_HEIGHT; 
-						term->state = _st_idle; 
-						break;
-					}
-					case 'C': { // cursor right (cursor stops at right margin)
-						int n = (term->narg > 0)?term->args[0]:1;
-						term->cursor_x += n;
-						if(term->cursor_x > VT100_WIDTH) term->cursor_x = VT100_WIDTH;
-						term->state = _st_idle; 
-						break;
-					}
-					case 'D': { // cursor left
-						int n = (term->narg > 0)?term->args[0]:1;
-						term->cursor_x -= n;
-						if(term->cursor_x < 0) term->cursor_x = 0;
-						term->state = _st_idle; 
-						break;
-					}
-					case 'f': 
-					case 'H': { // move cursor to position (default 0;0)
-						// cursor stops at respective margins
-						term->cursor_x = (term->narg >= 1)?(term->args[1]-1):0; 
-						term->cursor_y = (term->narg == 2)?(term->args[0]-1):0;
-						if(term->flags.origin_mode) {
-							term->cursor_y += term->scroll_start_row;
-							if(term->cursor_y >= term->scroll_end_row){
-								term->cursor_y = term->scroll_end_row - 1;
-							}
-						}
-						if(term->cursor_x > VT100_WIDTH) term->cursor_x = VT100_WIDTH;
-						if(term->cursor_y > VT100_HEIGHT) term->cursor_y = VT100_HEIGHT; 
-						term->state = _st_idle; 
-						break;
-					}
-					case 'J':{// clear screen from cursor up or down
-						uint16_t y = VT100_CURSOR_Y(term); 
-						if(term->narg == 0 || (term->narg == 1 && term->args[0] == 0)){
-							// clear down to the bottom of screen (including cursor)
-							_vt100_clearLines(term, term->cursor_y, VT100_HEIGHT); 
-						} else if(term->narg == 1 && term->args[0] == 1){
-							// clear top of screen to current line (including cursor)
-							_vt100_clearLines(term, 0, term->cursor_y); 
-						} else if(term->narg == 1 && term->args[0] == 2){
-							// clear whole screen
-							_vt100_clearLines(term, 0, VT100_HEIGHT);
-							// reset scroll value
-							_vt100_resetScroll(); 
-						}
-						term->state = _st_idle; 
-						break;
-					}
-					case 'K':{// clear line from cursor right/left
-						uint16_t x = VT100_CURSOR_X(term);
-						uint16_t y = VT100_CURSOR_Y(term);
-
-						if(term->narg == 0 || (term->narg == 1 && term->args[0] == 0)){
-							// clear to end of line (to \n or to edge?)
-							// including cursor
-							ili9340_fillRect(x, y, VT100_SCREEN_WIDTH - x, VT100_CHAR_HEIGHT, term->back_color);
-						} else if(term->narg == 1 && term->args[0] == 1){
-							// clear from left to current cursor position
-							ili9340_fillRect(0, y, x + VT100_CHAR_WIDTH, VT100_CHAR_HEIGHT, term->back_color);
-						} else if(term->narg == 1 && term->args[0] == 2){
-							// clear whole current line
-							ili9340_fillRect(0, y, VT100_SCREEN_WIDTH, VT100_CHAR_HEIGHT, term->back_color);
-						}
-						term->state = _st_idle; 
-						break;
-					}
-					
-					case 'L': // insert lines (args[0] = number of lines)
-					case 'M': // delete lines (args[0] = number of lines)
-						term->state = _st_idle;
-						break; 
-					case 'P': {// delete characters args[0] or 1 in front of cursor
-						// TODO: this needs to correctly delete n chars
-						int n = ((term->narg > 0)?term->args[0]:1);
-						_vt100_move(term, -n, 0);
-						for(int c = 0; c < n; c++){
-							_vt100_putc(term, ' ');
-						}
-						term->state = _st_idle;
-						break;
-					}
-					case 'c':{ // query device code
-						term->send_response("\e[?1;0c"); 
-						term->state = _st_idle; 
-						break; 
-					}
-					case 'x': {
-						term->state = _st_idle;
-						break;
-					}
-					case 's':{// save cursor pos
-						term->saved_cursor_x = term->cursor_x;
-						term->saved_cursor_y = term->cursor_y;
-						term->state = _st_idle; 
-						break;
-					}
-					case 'u':{// restore cursor pos
-						term->cursor_x = term->saved_cursor_x;
-						term->cursor_y = term->saved_cursor_y; 
-						//_vt100_moveCursor(term, term->saved_cursor_x, term->saved_cursor_y);
-						term->state = _st_idle; 
-						break;
-					}
-					case 'h':
-					case 'l': {
-						term->state = _st_idle;
-						break;
-					}
-					
-					case 'g': {
-						term->state = _st_idle;
-						break;
-					}
-					case 'm': { // sets colors. Accepts up to 3 args
-						// [m means reset the colors to default
-						if(!term->narg){
-							term->front_color = 0xffff;
-							term->back_color = 0x0000;
-						}
-						while(term->narg){
-							term->narg--; 
-							int n = term->args[term->narg];
-							static const uint16_t colors[] = {
-								0x0000, // black
-								0xf800, // red
-								0x0780, // green
-								0xfe00, // yellow
-								0x001f, // blue
-								0xf81f, // magenta
-								0x07ff, // cyan
-								0xffff // white
-							};
-							if(n == 0){ // all attributes off
-								term->front_color = 0xffff;
-								term->back_color = 0x0000;
-								
-								ili9340_setFrontColor(term->front_color);
-								ili9340_setBackColor(term->back_color);
-							}
-							if(n >= 30 && n < 38){ // fg colors
-								term->front_color = colors[n-30]; 
-								ili9340_setFrontColor(term->front_color);
-							} else if(n >= 40 && n < 48){
-								term->back_color = colors[n-40]; 
-								ili9340_setBackColor(term->back_color); 
-							}
-						}
-						term->state = _st_idle; 
-						break;
-					}
-					
-					case '@': // Insert Characters          
-						term->state = _st_idle;
-						break; 
-					case 'r': // Set scroll region (top and bottom margins)
-						// the top value is first row of scroll region
-						// the bottom value is the first row of static region after scroll
-						if(term->narg == 2 && term->args[0] < term->args[1]){
-							// [1;40r means scroll region between 8 and 312
-							// bottom margin is 320 - (40 - 1) * 8 = 8 pix
-							term->scroll_start_row = term->args[0] - 1;
-							term->scroll_end_row = term->args[1] - 1; 
-							uint16_t top_margin = term->scroll_start_row * VT100_CHAR_HEIGHT;
-							uint16_t bottom_margin = VT100_SCREEN_HEIGHT -
-								(term->scroll_end_row * VT100_CHAR_HEIGHT); 
-							ili9340_setScrollMargins(top_margin, bottom_margin);
-							//ili9340_setScrollStart(0); // reset scroll 
-						} else {
-							_vt100_resetScroll(); 
-						}
-						term->state = _st_idle; 
-						break;  
-					case 'i': // Printing  
-					case 'y': // self test modes..
-					case '=':{ // argument follows... 
-						//term->state = _st_screen_mode;
-						term->state = _st_idle; 
-						break; 
-					}
-					case '?': // '[?' escape mode
-						term->state = _st_esc_question;
-						break; 
-
-          case 'q' :  vt100_puts("\r\n"); // on-screen LEDS added PS
-                      char bfr[20];
-                      switch (term->args[0])
-                      { case 0 : ili9340_drawRect(186,6,10,10,ILI9340_RED,ILI9340_BLACK);
-                                 ili9340_drawRect(200,6,10,10,ILI9340_RED,ILI9340_BLACK);
-                                 ili9340_drawRect(214,6,10,10,ILI9340_RED,ILI9340_BLACK);
-                                 ili9340_drawRect(228,6,10,10,ILI9340_RED,ILI9340_BLACK);
-                                 break;                     
-                        case 1 : ili9340_fillRect(186,6,10,10,ILI9340_RED); break;
-                        case 2 : ili9340_fillRect(200,6,10,10,ILI9340_RED); break;
-                        case 3 : ili9340_fillRect(214,6,10,10,ILI9340_RED); break;
-                        case 4 : ili9340_fillRect(228,6,10,10,ILI9340_RED); break;
-                        
-                        case 5 : ili9340_drawRect(186,6,10,10,ILI9340_RED,ILI9340_BLACK); break;
-                        case 6 : ili9340_drawRect(200,6,10,10,ILI9340_RED,ILI9340_BLACK); break;
-                        case 7 : ili9340_drawRect(214,6,10,10,ILI9340_RED,ILI9340_BLACK); break;
-                        case 8 : ili9340_drawRect(228,6,10,10,ILI9340_RED,ILI9340_BLACK); break;
-                      }
-                      term->state = _st_idle;
-                      break;
-          case 'X' : // Baud Rate setting added PS
-                  switch (term->args[0])
-                      { case 1 : Serial1.end(); Serial1.begin(300); strcpy(new_br,"300   "); break;
-                        case 2 : Serial1.end(); Serial1.begin(2400); strcpy(new_br,"2400  "); break;
-                        case 3 : Serial1.end(); Serial1.begin(9600); strcpy(new_br,"9600  "); break;
-                        case 4 : Serial1.end(); Serial1.begin(57600); strcpy(new_br,"57600 "); break;
-                        case 5 : Serial1.end(); Serial1.begin(76800); strcpy(new_br,"76800 "); break;
-                        case 6 : Serial1.end(); Serial1.begin(115200); strcpy(new_br,"115200"); break;
-                      }
-                      EEPROM.update(BAUD_STORE, term->args[0]);
-                      EEPROM.update(BAUD_STORE+1, term->args[0]^0xff);                      
-                      term->state = _st_idle;
-                      break;  
- 
-					default: { // unknown sequence
-						
-						term->state = _st_idle;
-						break;
-					}
-				}
-				//term->state = _st_idle;
-			} // else
-			break;
-		}
-		default: { // switch (ev)
-			// for all other events restore normal mode
-			term->state = _st_idle; 
-		}
-	}
-}
-
-STATE(_st_esc_question, term, ev, arg){
-	// DEC mode commands
-	switch(ev){
-		case EV_CHAR: {
-			if(isdigit(arg)){ // start of an argument
-				term->ret_state = _st_esc_question; 
-				_st_command_arg(term, ev, arg);
-				term->state = _st_command_arg;
-			} else if(arg == ';'){ // arg separator. 
-				// skip. And also stay in the command state
-			} else {
-				switch(arg) {
-					case 'l': 
-						// dec mode: OFF (arg[0] = function)
-					case 'h': {
-						// dec mode: ON (arg[0] = function)
-						switch(term->args[0]){
-							case 1: { // cursor keys mode
-								// h = esc 0 A for cursor up
-								// l = cursor keys send ansi commands
-								break;
-							}
-							case 2: { // ansi / vt52
-								// h = ansi mode
-								// l = vt52 mode
-								break;
-							}
-							case 3: {
-								// h = 132 chars per line
-								// l = 80 chars per line
-								break;
-							}
-							case 4: {
-								// h = smooth scroll
-								// l = jump scroll
-								break;
-							}
-							case 5: {
-								// h = black on white bg
-								// l = white on black bg
-								break;
-							}
-							case 6: {
-								// h = cursor relative to scroll region
-								// l = cursor independent of scroll region
-								term->flags.origin_mode = (arg == 'h')?1:0; 
-								break;
-							}
-							case 7: {
-								// h = new line after last column
-								// l = cursor stays at the end of line
-								term->flags.cursor_wrap = (arg == 'h')?1:0; 
-								break;
-							}
-							case 8: {
-								// h = keys will auto repeat
-								// l = keys do not auto repeat when held down
-								break;
-							}
-							case 9: {
-								// h = display interlaced
-								// l = display not interlaced
-								break;
-							}
-							// 10-38 - all quite DEC speciffic commands so omitted here
-						}
-						term->state = _st_idle;
-						break; 
-					}
-					case 'i': /* Printing */  
-					case 'n': /* Request printer status */
-					default:  
-						term->state = _st_idle; 
-						break;
-				}
-				term->state = _st_idle;
-			}
-		}
-	}
-}
-
-STATE(_st_esc_left_br, term, ev, arg){
-	switch(ev){
-		case EV_CHAR: {
-			switch(arg) {  
-				case 'A':  
-				case 'B':  
-					// translation map command?
-				case '0':  
-				case 'O':
-					// another translation map command?
-					term->state = _st_idle;
-					break;
-				default:
-					term->state = _st_idle;
-			}
-			//term->state = _st_idle;
-		}
-	}
-}
-
-STATE(_st_esc_right_br, term, ev, arg){
-	switch(ev){
-		case EV_CHAR: {
-			switch(arg) {  
-				case 'A':  
-				case 'B':  
-					// translation map command?
-				case '0':  
-				case 'O':
-					// another translation map command?
-					term->state = _st_idle;
-					break;
-				default:
-					term->state = _st_idle;
-			}
-			//term->state = _st_idle;
-		}
-	}
-}
-
-STATE(_st_esc_hash, term, ev, arg){
-	switch(ev){
-		case EV_CHAR: {
-			switch(arg) {  
-				case '8': {
-					// self test: fill the screen with 'E'
-					
-					term->state = _st_idle;
-					break;
-				}
-				default:
-					term->state = _st_idle;
-			}
-		}
-	}
-}
-
-STATE(_st_escape, term, ev, arg){
-	switch(ev){
-		case EV_CHAR: {
-			#define CLEAR_ARGS \
-				{ term->narg = 0;\
-				for(int c = 0; c < MAX_COMMAND_ARGS; c++)\
-					term->args[c] = 0; }\
-			
-			switch(arg){
-				case '[': { // command
-					// prepare command state and switch to it
-					CLEAR_ARGS; 
-					term->state = _st_esc_sq_bracket;
-					break;
-				}
-				case '(': /* ESC ( */  
-					CLEAR_ARGS;
-					term->state = _st_esc_left_br;
-					break; 
-				case ')': /* ESC ) */  
-					CLEAR_ARGS;
-					term->state = _st_esc_right_br;
-					break;  
-				case '#': // ESC # 
-					CLEAR_ARGS;
-					term->state = _st_esc_hash;
-					break;  
-				case 'P': //ESC P (DCS, Device Control String)
-					term->state = _st_idle; 
-					break;
-				case 'D': // moves cursor down one line and scrolls if necessary
-					// move cursor down one line and scroll window if at bottom line
-					_vt100_move(term, 0, 1); 
-					term->state = _st_idle;
-					break; 
-				case 'M': // Cursor up
-					// move cursor up one line and scroll window if at top line
-					_vt100_move(term, 0, -1); 
-					term->state = _st_idle;
-					break; 
-				case 'E': // next line
-					// same as '\r\n'
-					_vt100_move(term, 0, 1);
-					term->cursor_x = 0; 
-					term->state = _st_idle;
-					break;  
-				case '7': // Save attributes and cursor position  
-          term->saved_cursor_x = term->cursor_x;
-          term->saved_cursor_y = term->cursor_y;
-          term->saved_back_color = term->back_color;
-          term->saved_front_color = term->front_color;
-          term->state = _st_idle;
-          break;  
-				case 's':  
-					term->saved_cursor_x = term->cursor_x;
-					term->saved_cursor_y = term->cursor_y;
-					term->state = _st_idle;
-					break;  
-				case '8': // Restore them  
-          term->cursor_x = term->saved_cursor_x;
-          term->cursor_y = term->saved_cursor_y; 
-          term->back_color = term->saved_back_color;
-          term->front_color = term->saved_front_color; 
-          term->state = _st_idle;
-          break; 
-				case 'u': 
-					term->cursor_x = term->saved_cursor_x;
-					term->cursor_y = term->saved_cursor_y; 
-					term->state = _st_idle;
-					break; 
-				case '=': // Keypad into applications mode 
-					term->state = _st_idle;
-					break; 
-				case '>': // Keypad into numeric mode   
-					term->state = _st_idle;
-					break;  
-				case 'Z': // Report terminal type 
-					// vt 100 response
-					term->send_response("\033[?1;0c");  
-					// unknown terminal     
-						//out("\033[?c");
-					term->state = _st_idle;
-					break;    
-				case 'c': // Reset terminal to initial state 
-					_vt100_reset();
-					term->state = _st_idle;
-					break;  
-				case 'H': // Set tab in current position 
-				case 'N': // G2 character set for next character only  
-				case 'O': // G3 "               "     
-				case '<': // Exit vt52 mode
-					// ignore
-					term->state = _st_idle;
-					break; 
-				case KEY_ESC: { // marks start of next escape sequence
-					// stay in escape state
-					break;
-				}
-				default: { // unknown sequence - return to normal mode
-					term->state = _st_idle;
-					break;
-				}
-			}
-			#undef CLEAR_ARGS
-			break;
-		}
-		default: {
-			// for all other events restore normal mode
-			term->state = _st_idle; 
-		}
-	}
-}
-
-STATE(_st_idle, term, ev, arg){
-	switch(ev){
-		case EV_CHAR: {
-			switch(arg){
-				
-				case 5: // AnswerBack for vt100's  
-					term->send_response("X"); // should send SCCS_ID?
-					break;  
-				case '\n': { // new line
-					_vt100_move(term, 0, 1);
-					term->cursor_x = 0; 
-					//_vt100_moveCursor(term, 0, term->cursor_y + 1);
-					// do scrolling here! 
-					break;
-				}
-				case '\r': { // carrage return (0x0d)
-					term->cursor_x = 0; 
-					//_vt100_move(term, 0, 1);
-					//_vt100_moveCursor(term, 0, term->cursor_y); 
-					break;
-				}
-				case '\b': { // backspace 0x08
-					_vt100_move(term, -1, 0); 
-					// backspace does not delete the character! Only moves cursor!
-					//ili9340_drawChar(term->cursor_x * term->char_width,
-					//	term->cursor_y * term->char_height, ' ');
-					break;
-				}
-				case KEY_DEL: { // del - delete character under cursor
-					// Problem: with current implementation, we can't move the rest of line
-					// to the left as is the proper behavior of the delete character
-					// fill the current position with background color
-					_vt100_putc(term, ' ');
-					_vt100_move(term, -1, 0);
-					//_vt100_clearChar(term, term->cursor_x, term->cursor_y); 
-					break;
-				}
-				case '\t': { // tab
-					// tab fills characters on the line until we reach a multiple of tab_stop
-					int tab_stop = 4;
-					int to_put = tab_stop - (term->cursor_x % tab_stop); 
-					while(to_put--) _vt100_putc(term, ' ');
-					break;
-				}
-				case KEY_BELL: { // bell is sent by bash for ex. when doing tab completion
-					// sound the speaker bell?
-					// skip
-					break; 
-				}
-				case KEY_ESC: {// escape
-					term->state = _st_escape;
-					break;
-				}
-				default: {
-					_vt100_putc(term, arg);
-					break;
-				}
-			}
-			break;
-		}
-		default: {}
-	}
-}
-
-void vt100_init(void (*send_response)(char *str)){
-  term.send_response = send_response; 
-	_vt100_reset(); 
-}
-
-void vt100_putc(uint8_t c){
-	/*char *buffer = 0; 
-	switch(c){
-		case KEY_UP:         buffer="\e[A";    break;
-		case KEY_DOWN:       buffer="\e[B";    break;
-		case KEY_RIGHT:      buffer="\e[C";    break;
-		case KEY_LEFT:       buffer="\e[D";    break;
-		case KEY_BACKSPACE:  buffer="\b";      break;
-		case KEY_IC:         buffer="\e[2~";   break;
-		case KEY_DC:         buffer="\e[3~";   break;
-		case KEY_HOME:       buffer="\e[7~";   break;
-		case KEY_END:        buffer="\e[8~";   break;
-		case KEY_PPAGE:      buffer="\e[5~";   break;
-		case KEY_NPAGE:      buffer="\e[6~";   break;
-		case KEY_SUSPEND:    buffer="\x1A";    break;      // ctrl-z
-		case KEY_F(1):       buffer="\e[[A";   break;
-		case KEY_F(2):       buffer="\e[[B";   break;
-		case KEY_F(3):       buffer="\e[[C";   break;
-		case KEY_F(4):       buffer="\e[[D";   break;
-		case KEY_F(5):       buffer="\e[[E";   break;
-		case KEY_F(6):       buffer="\e[17~";  break;
-		case KEY_F(7):       buffer="\e[18~";  break;
-		case KEY_F(8):       buffer="\e[19~";  break;
-		case KEY_F(9):       buffer="\e[20~";  break;
-		case KEY_F(10):      buffer="\e[21~";  break;
-	}
-	if(buffer){
-		while(*buffer){
-			term.state(&term, EV_CHAR, *buffer++);
-		}
-	} else {
-		term.state(&term, EV_CHAR, 0x0000 | c);
-	}*/
-	term.state(&term, EV_CHAR, 0x0000 | c);
-}
+/**
+	This file is part of FORTMAX.
+
+	FORTMAX is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	FORTMAX is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with FORTMAX.  If not, see <http://www.gnu.org/licenses/>.
+
+	Copyright: Martin K. Schröder (info@fortmax.se) 2014
+*/
+
+#include <ctype.h>
+#include <math.h>
+#include <arduino.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <EEPROM.h>
+
+#include "vt100.h"
+#include "uart.h"
+#include "display.h"
+#include "profile.h"
+#include "latency.h"
+
+char new_br[8];
+
+#define KEY_ESC 0x1b
+#define KEY_DEL 0x7f
+#define KEY_BELL 0x07
+
+// parser states
+enum {
+	STATE_GROUND,
+	STATE_ESCAPE,
+	STATE_ESC_INTER,
+	STATE_CSI_ENTRY,
+	STATE_CSI_PARAM,
+	STATE_CSI_INTER,
+	STATE_CSI_IGNORE,
+	STATE_STRING,
+	STATE_COUNT
+};
+
+// classes that input bytes are sorted into before the state table lookup
+enum {
+	CL_C0,
+	CL_BEL,
+	CL_CAN,
+	CL_ESC,
+	CL_INTER,
+	CL_DIGIT,
+	CL_COLON,
+	CL_SEMI,
+	CL_PRIV,
+	CL_CSI,
+	CL_STRING,
+	CL_FINAL,
+	CL_DEL,
+	CL_HIGH,
+	CL_COUNT
+};
+
+// actions run on a transition
+enum {
+	ACT_NONE,
+	ACT_PRINT,
+	ACT_EXECUTE,
+	ACT_CLEAR,
+	ACT_COLLECT,
+	ACT_PARAM,
+	ACT_ESC_DISPATCH,
+	ACT_CSI_DISPATCH
+};
+
+#define MAX_COMMAND_ARGS 8
+#define MAX_INTERMEDIATES 2
+
+// an attribute is a pair of indexes into _vt100_colors: fg in the low
+// nibble, bg in the high nibble
+#define VT100_ATTR(FG, BG) (((BG) << 4) | (FG))
+#define VT100_ATTR_FG(A) ((A) & 0x0f)
+#define VT100_ATTR_BG(A) ((A) >> 4)
+#define VT100_DEFAULT_ATTR VT100_ATTR(7, 0)
+
+static const uint16_t _vt100_colors[] = {
+	0x0000, // black
+	0xf800, // red
+	0x0780, // green
+	0xfe00, // yellow
+	0x001f, // blue
+	0xf81f, // magenta
+	0x07ff, // cyan
+	0xffff // white
+};
+
+// replies to the host waiting to be picked up by vt100_txChunk()
+struct vt100_tx {
+	uint8_t buf[VT100_TX_SIZE];
+	uint8_t head, tail;
+	// a table going out a line at a time (the latency histogram or the
+	// profile), and the line it is at
+	uint8_t (*dump)(uint8_t line, char *buf, uint8_t size);
+	uint8_t dump_line;
+};
+
+#define TX_MASK (VT100_TX_SIZE - 1)
+
+// shadow copy of the text in display ram. Rows are display ram rows (not
+// screen rows) so a hardware scroll does not move anything around here.
+// Changed cells are collected in a dirty span per row and repainted by
+// _vt100_flush().
+struct vt100_screen {
+	uint8_t chars[VT100_MAX_HEIGHT][VT100_MAX_WIDTH];
+	uint8_t attrs[VT100_MAX_HEIGHT][VT100_MAX_WIDTH];
+	// what the panel currently shows. Only cells that differ from it are sent.
+	uint8_t shown_chars[VT100_MAX_HEIGHT][VT100_MAX_WIDTH];
+	uint8_t shown_attrs[VT100_MAX_HEIGHT][VT100_MAX_WIDTH];
+	uint8_t dirty[(VT100_MAX_HEIGHT + 7) / 8]; // one bit per row
+	uint8_t dirty_from[VT100_MAX_HEIGHT], dirty_to[VT100_MAX_HEIGHT];
+	// hardware scroll start wanted by the terminal and the one last sent.
+	// Scrolling only updates the first, flush sends it once per frame.
+	uint16_t scroll_start, shown_scroll_start;
+#if DISPLAY_COPY
+	// lines the scroll region (rows copy_top up to copy_end) has scrolled
+	// up by in software since the last flush. The panel gets one copy for
+	// all of them, see _vt100_copyScroll().
+	uint8_t copy_lines;
+	int16_t copy_top, copy_end;
+#endif
+	// 0 = repaint after every write, otherwise minimum ms between repaints
+	uint16_t frame_ms;
+	uint32_t flushed_at;
+	// micros() the byte being timed for latency.h came in at, it is on the
+	// panel after the next repaint
+	uint8_t stamped;
+	uint32_t stamp;
+	// repaints held off while the input backlog is high, and the input
+	// bytes taken in meanwhile
+	uint8_t skipping;
+	uint32_t skipped;
+};
+
+// attribute that never occurs in the screen, marks a panel cell as unknown
+#define VT100_NO_ATTR 0xff
+
+#if VT100_ALT_SCREEN
+// the screen that is not in use - the main one while the alternate one is
+// shown and the other way round. _vt100_altScreen() swaps it with the
+// shadow screen and the scroll state.
+struct vt100_hidden {
+	uint8_t chars[VT100_MAX_HEIGHT][VT100_MAX_WIDTH];
+	uint8_t attrs[VT100_MAX_HEIGHT][VT100_MAX_WIDTH];
+#if DISPLAY_LAYERS > 1
+	// it stays on its own display layer, which still shows this
+	uint8_t shown_chars[VT100_MAX_HEIGHT][VT100_MAX_WIDTH];
+	uint8_t shown_attrs[VT100_MAX_HEIGHT][VT100_MAX_WIDTH];
+	uint16_t shown_scroll_start;
+#endif
+	uint16_t scroll_start;
+	int16_t scroll_start_row, scroll_end_row;
+	uint16_t scroll_value;
+};
+#endif
+
+// one terminal. Every function works on the one it is given, so several
+// can share the panel, each in its own viewport.
+struct vt100 {
+	union flags {
+		uint8_t val;
+    		struct {
+    			// 0 = cursor remains on last column when it gets there
+    			// 1 = lines wrap after last column to next line
+    			uint8_t cursor_wrap : 1; 
+    			uint8_t scroll_mode : 1;
+    			uint8_t origin_mode : 1; 
+    			uint8_t alt_screen : 1; // the alternate screen is shown
+    			uint8_t hw_scroll : 1; // scrolls with the panel's scroll window
+    			uint8_t whole_panel : 1; // the viewport is all of the panel
+    		  }; 
+	      } flags;
+	
+	// viewport: top left corner in pixels and size in characters
+	uint16_t x, y;
+	uint8_t width, height;
+	// cursor position on the screen (0, 0) = top left corner. 
+	int16_t cursor_x, cursor_y;
+	int16_t saved_cursor_x, saved_cursor_y; // used for cursor save restore
+	int16_t scroll_start_row, scroll_end_row; 
+	// character width and height
+	int8_t char_width, char_height;
+	// attribute used for rendering current characters
+	uint8_t attr;
+	uint8_t saved_attr; // used for cursor save restore 7 and 8 - added ps
+	// the starting y-position of the screen scroll
+	uint16_t scroll_value; 
+	// command arguments that get parsed as they appear in the terminal
+	uint8_t narg; uint16_t args[MAX_COMMAND_ARGS];
+	// private marker (one of < = > ?) and intermediate bytes of a sequence
+	uint8_t priv;
+	uint8_t ninter; uint8_t inter[MAX_INTERMEDIATES];
+	
+	uint8_t state;
+
+	struct vt100_screen screen;
+#if VT100_ALT_SCREEN
+	struct vt100_hidden hidden;
+#endif
+	struct vt100_tx tx;
+};
+
+static struct vt100 terms[VT100_INSTANCES];
+
+// tells the panel the scroll region of the terminal that has the hardware
+// scroll. A viewport that isn't a whole number of rows high keeps the rest
+// of it at the bottom, out of the scroll area.
+void _vt100_setMargins(struct vt100 *t){
+	if(!t->flags.hw_scroll) return;
+	display_setScrollMargins(t->y + t->scroll_start_row * VT100_CHAR_HEIGHT,
+		VT100_SCREEN_HEIGHT - t->y - t->scroll_end_row * VT100_CHAR_HEIGHT);
+}
+
+void _vt100_resetScroll(struct vt100 *t);
+
+void _vt100_reset(struct vt100 *t){
+	//term.screen_width = VT100_SCREEN_WIDTH;
+  //term.screen_height = VT100_SCREEN_HEIGHT;
+  t->char_height = VT100_CHAR_HEIGHT;
+  t->char_width = VT100_CHAR_WIDTH;
+  t->attr = t->saved_attr = VT100_DEFAULT_ATTR;
+  t->cursor_x = t->cursor_y = t->saved_cursor_x = t->saved_cursor_y = 0;
+  t->narg = 0;
+  t->state = STATE_GROUND;
+  t->flags.cursor_wrap = 0;
+  t->flags.origin_mode = 0; 
+	_vt100_resetScroll(t); // outside of screen = whole screen scrollable
+}
+
+void _vt100_unscroll(struct vt100 *t);
+
+// sets the scroll region to screen rows start up to (not including) end
+void _vt100_setRegion(struct vt100 *t, int16_t start, int16_t end){
+	_vt100_unscroll(t);
+	t->scroll_start_row = start;
+	t->scroll_end_row = end;
+	_vt100_setMargins(t);
+	// nothing scrolled yet, the region shows its display ram rows in order
+	t->screen.scroll_start = t->y + start * VT100_CHAR_HEIGHT;
+}
+
+void _vt100_resetScroll(struct vt100 *t){
+	_vt100_setRegion(t, 0, t->height);
+}
+
+// queues a reply to the host. A reply that doesn't fit is dropped whole
+// rather than sent in pieces.
+void _vt100_respond(struct vt100 *t, const char *str){
+	uint8_t len = strlen(str);
+	if(len > ((t->tx.tail - t->tx.head - 1) & TX_MASK)) return;
+	while(len--){
+		t->tx.buf[t->tx.head] = *str++;
+		t->tx.head = (t->tx.head + 1) & TX_MASK;
+	}
+}
+
+#define VT100_CURSOR_X(TERM) (TERM->cursor_x * TERM->char_width)
+
+// display ram text row that a screen row is currently shown on
+inline uint16_t _vt100_physRow(struct vt100 *t, int16_t row){
+	// if within the top or bottom margin areas then normal addressing
+	if(row < t->scroll_start_row || row >= t->scroll_end_row){
+		return row; 
+	} else {
+		// otherwise we are inside scroll area
+		uint16_t scroll_height = t->scroll_end_row - t->scroll_start_row;
+		uint16_t r = row + t->scroll_value; 
+		if(row + t->scroll_value >= t->scroll_end_row)
+			r -= scroll_height; 
+		return r; 
+	}
+}
+
+void _vt100_markDirty(struct vt100 *t, uint16_t row, uint8_t from, uint8_t to){
+	uint8_t bit = _BV(row & 7);
+	if(!(t->screen.dirty[row >> 3] & bit)){
+		t->screen.dirty[row >> 3] |= bit;
+		t->screen.dirty_from[row] = from;
+		t->screen.dirty_to[row] = to;
+	} else {
+		if(from < t->screen.dirty_from[row]) t->screen.dirty_from[row] = from;
+		if(to > t->screen.dirty_to[row]) t->screen.dirty_to[row] = to;
+	}
+}
+
+// stores characters in the shadow screen. Cells that already hold the
+// same character and attribute are not marked for repainting. Rows below
+// the viewport (the cursor can sit on the one just past it) are dropped,
+// on the panel they belong to whatever is under it.
+void _vt100_setCells(struct vt100 *t, uint16_t row, int16_t col, const uint8_t *chars, uint8_t attr, uint8_t len){
+	if(row >= t->height || col < 0 || col >= t->width) return;
+	if(col + len > t->width) len = t->width - col;
+
+	uint8_t *c = &t->screen.chars[row][col];
+	uint8_t *a = &t->screen.attrs[row][col];
+	int16_t first = -1, last = 0;
+	for(uint8_t i = 0; i < len; i++){
+		if(c[i] != chars[i] || a[i] != attr){
+			c[i] = chars[i];
+			a[i] = attr;
+			if(first < 0) first = i;
+			last = i;
+		}
+	}
+	if(first >= 0) _vt100_markDirty(t, row, col + first, col + last);
+}
+
+// same as _vt100_setCells() with one repeated character
+void _vt100_fillCells(struct vt100 *t, uint16_t row, int16_t col, uint8_t ch, uint8_t attr, uint8_t len){
+	if(row >= t->height || col < 0 || col >= t->width) return;
+	if(col + len > t->width) len = t->width - col;
+
+	uint8_t *c = &t->screen.chars[row][col];
+	uint8_t *a = &t->screen.attrs[row][col];
+	int16_t first = -1, last = 0;
+	for(uint8_t i = 0; i < len; i++){
+		if(c[i] != ch || a[i] != attr){
+			c[i] = ch;
+			a[i] = attr;
+			if(first < 0) first = i;
+			last = i;
+		}
+	}
+	if(first >= 0) _vt100_markDirty(t, row, col + first, col + last);
+}
+
+// reverses the order of count shadow screen rows from row first
+static void _vt100_reverseRows(struct vt100 *t, uint16_t first, uint16_t count){
+	uint8_t tmp[VT100_MAX_WIDTH];
+	for(uint16_t a = first, b = first + count - 1; count && a < b; a++, b--){
+		memcpy(tmp, t->screen.chars[a], t->width);
+		memcpy(t->screen.chars[a], t->screen.chars[b], t->width);
+		memcpy(t->screen.chars[b], tmp, t->width);
+		memcpy(tmp, t->screen.attrs[a], t->width);
+		memcpy(t->screen.attrs[a], t->screen.attrs[b], t->width);
+		memcpy(t->screen.attrs[b], tmp, t->width);
+	}
+}
+
+// undoes the hardware scroll before the scroll region changes: the rows
+// of the region go back to screen order in the shadow screen, and with
+// the scroll start back at the top of the region the panel shows them that
+// way too. Display ram still holds them rotated, so the region is
+// repainted wherever that differs.
+void _vt100_unscroll(struct vt100 *t){
+	if(!t->scroll_value) return;
+	uint16_t first = t->scroll_start_row;
+	uint16_t rows = t->scroll_end_row - t->scroll_start_row;
+	// rotate up by scroll_value rows: reverse both parts, then the whole
+	_vt100_reverseRows(t, first, t->scroll_value);
+	_vt100_reverseRows(t, first + t->scroll_value, rows - t->scroll_value);
+	_vt100_reverseRows(t, first, rows);
+	for(uint16_t row = first; row < first + rows; row++){
+		_vt100_markDirty(t, row, 0, t->width - 1);
+	}
+	t->scroll_value = 0;
+}
+
+// a dirty row that is blank in one attribute and differs from the panel
+// in every cell is filled whole, together with like rows below it. Rows
+// with cells already showing blank go through the runs instead, so no
+// pixel is sent twice. Returns the attribute or VT100_NO_ATTR.
+uint8_t _vt100_blankRow(struct vt100 *t, uint16_t row){
+	if(row >= VT100_MAX_HEIGHT || !(t->screen.dirty[row >> 3] & _BV(row & 7))) return VT100_NO_ATTR;
+	uint8_t attr = t->screen.attrs[row][0];
+	for(uint8_t col = 0; col < t->width; col++){
+		if(t->screen.chars[row][col] != ' ' || t->screen.attrs[row][col] != attr) return VT100_NO_ATTR;
+		if(t->screen.shown_chars[row][col] == ' ' && t->screen.shown_attrs[row][col] == attr) return VT100_NO_ATTR;
+	}
+	return attr;
+}
+
+#if DISPLAY_COPY
+void _vt100_copyScroll(struct vt100 *t);
+#endif
+
+// repaints the dirty spans of the shadow screen. Cells the panel already
+// shows are skipped, the rest is drawn with one call per run of cells
+// that share an attribute. Runs of spaces are filled with the background
+// colour, and cleared rows that are next to each other in display ram
+// are filled together.
+void _vt100_flush(struct vt100 *t){
+	PROFILE_START(start);
+#if DISPLAY_COPY
+	_vt100_copyScroll(t);
+#endif
+	for(uint16_t row = 0; row < VT100_MAX_HEIGHT; row++){
+		if(!t->screen.dirty[row >> 3]){
+			row |= 7; // skip 8 clean rows at once
+			continue;
+		}
+		uint8_t bit = _BV(row & 7);
+		if(!(t->screen.dirty[row >> 3] & bit)) continue;
+
+		uint8_t blank = _vt100_blankRow(t, row);
+		if(blank != VT100_NO_ATTR){
+			uint16_t rows = 0;
+			do {
+				t->screen.dirty[(row + rows) >> 3] &= ~_BV((row + rows) & 7);
+				memset(t->screen.shown_chars[row + rows], ' ', t->width);
+				memset(t->screen.shown_attrs[row + rows], blank, t->width);
+				rows++;
+			} while(_vt100_blankRow(t, row + rows) == blank);
+			display_fillRect(t->x, t->y + row * VT100_CHAR_HEIGHT, t->width * VT100_CHAR_WIDTH,
+				rows * VT100_CHAR_HEIGHT, _vt100_colors[VT100_ATTR_BG(blank)]);
+			row += rows - 1;
+			continue;
+		}
+		t->screen.dirty[row >> 3] &= ~bit;
+
+		uint8_t *chars = t->screen.chars[row], *attrs = t->screen.attrs[row];
+		uint8_t *shown_chars = t->screen.shown_chars[row], *shown_attrs = t->screen.shown_attrs[row];
+		uint8_t col = t->screen.dirty_from[row], end = t->screen.dirty_to[row];
+		while(col <= end){
+			uint8_t attr = attrs[col];
+			if(chars[col] == shown_chars[col] && attr == shown_attrs[col]){
+				col++;
+				continue;
+			}
+			uint8_t n = 1;
+			while(col + n <= end && attrs[col + n] == attr &&
+				(chars[col + n] != shown_chars[col + n] || shown_attrs[col + n] != attr)) n++;
+			uint8_t spaces = 0;
+			while(spaces < n && chars[col + spaces] == ' ') spaces++;
+			if(spaces == n){
+				display_fillRect(t->x + col * VT100_CHAR_WIDTH, t->y + row * VT100_CHAR_HEIGHT, n * VT100_CHAR_WIDTH,
+					VT100_CHAR_HEIGHT, _vt100_colors[VT100_ATTR_BG(attr)]);
+			} else {
+				display_setFrontColor(_vt100_colors[VT100_ATTR_FG(attr)]);
+				display_setBackColor(_vt100_colors[VT100_ATTR_BG(attr)]);
+				display_drawChars(t->x + col * VT100_CHAR_WIDTH, t->y + row * VT100_CHAR_HEIGHT, &chars[col], n);
+			}
+			memcpy(&shown_chars[col], &chars[col], n);
+			memset(&shown_attrs[col], attr, n);
+			col += n;
+		}
+	}
+	// scroll start goes out after the rows are drawn, so all lines
+	// scrolled since the last flush cost a single 0x37 command
+	if(t->flags.hw_scroll && t->screen.scroll_start != t->screen.shown_scroll_start){
+		display_setScrollStart(t->screen.scroll_start);
+		t->screen.shown_scroll_start = t->screen.scroll_start;
+	}
+	if(t->screen.stamped){
+#if VT100_DLIST
+		// timed when the list gets to the panel
+		dlist_latency(t->screen.stamp);
+#else
+		latency_add(micros() - t->screen.stamp);
+#endif
+		t->screen.stamped = 0;
+	}
+	PROFILE_END(PROFILE_FLUSH, start);
+}
+
+#if VT100_ALT_SCREEN
+static void _vt100_swap(void *a, void *b, size_t len){
+	uint8_t *p = (uint8_t *)a, *q = (uint8_t *)b;
+	while(len--){
+		uint8_t c = *p;
+		*p++ = *q;
+		*q++ = c;
+	}
+}
+
+#define VT100_SWAP(A, B) _vt100_swap(&(A), &(B), sizeof(A))
+
+// switches between the main and the alternate screen. With a second
+// display layer each screen keeps its pixels and switching is a register
+// write, otherwise the rows that differ are repainted. Layers show the
+// whole panel, so that is only for a terminal that has all of it.
+void _vt100_altScreen(struct vt100 *t, uint8_t on){
+	if(on == t->flags.alt_screen) return;
+	// what is pending belongs to the screen being left
+	_vt100_flush(t);
+	t->flags.alt_screen = on;
+	VT100_SWAP(t->screen.chars, t->hidden.chars);
+	VT100_SWAP(t->screen.attrs, t->hidden.attrs);
+	VT100_SWAP(t->screen.scroll_start, t->hidden.scroll_start);
+	VT100_SWAP(t->scroll_start_row, t->hidden.scroll_start_row);
+	VT100_SWAP(t->scroll_end_row, t->hidden.scroll_end_row);
+	VT100_SWAP(t->scroll_value, t->hidden.scroll_value);
+#if DISPLAY_LAYERS > 1
+	if(t->flags.whole_panel){
+		VT100_SWAP(t->screen.shown_chars, t->hidden.shown_chars);
+		VT100_SWAP(t->screen.shown_attrs, t->hidden.shown_attrs);
+		VT100_SWAP(t->screen.shown_scroll_start, t->hidden.shown_scroll_start);
+		display_setLayer(on);
+		return;
+	}
+#endif
+	_vt100_setMargins(t);
+	for(uint16_t row = 0; row < t->height && row < VT100_MAX_HEIGHT; row++){
+		_vt100_markDirty(t, row, 0, t->width - 1);
+	}
+}
+#endif
+
+void _vt100_clearLines(struct vt100 *t, uint16_t start_line, uint16_t end_line){
+	for(int c = start_line; c <= end_line && c < t->height; c++){
+		_vt100_fillCells(t, _vt100_physRow(t, c), 0, ' ', VT100_DEFAULT_ATTR, t->width);
+	}
+	/*uint16_t start = ((start_line * t->char_height) + t->scroll) % VT100_SCREEN_HEIGHT;
+	uint16_t h = (end_line - start_line) * VT100_CHAR_HEIGHT;
+	display_fillRect(0, start, VT100_SCREEN_WIDTH, h, 0x0000); */
+}
+
+void _vt100_shiftRows(struct vt100 *t, int16_t top, int16_t lines);
+#if DISPLAY_COPY
+void _vt100_scrollUp(struct vt100 *t, int16_t lines);
+#endif
+
+// scrolls the scroll region up (lines > 0) or down (lines < 0). Without
+// the hardware scroll the rows are moved instead, as deleting (or
+// inserting) lines at the top of the region would.
+void _vt100_scroll(struct vt100 *t, int16_t lines){
+	if(!lines) return;
+	if(!t->flags.hw_scroll){
+#if DISPLAY_COPY
+		if(lines > 0){
+			_vt100_scrollUp(t, lines);
+			return;
+		}
+#endif
+		_vt100_shiftRows(t, t->scroll_start_row, -lines);
+		return;
+	}
+
+	// get height of scroll area in rows
+	uint16_t scroll_height = t->scroll_end_row - t->scroll_start_row; 
+	// a jump of a whole screen or more only needs every row cleared once,
+	// rows that would scroll off again are never drawn
+	int16_t clear = (lines > 0)?lines:-lines;
+	if(clear > scroll_height) clear = scroll_height;
+	// clearing of lines that we have scrolled up or down
+	if(lines > 0){
+		_vt100_clearLines(t, t->scroll_start_row, t->scroll_start_row+clear-1); 
+		// update the scroll value (wraps around scroll_height)
+		t->scroll_value = (t->scroll_value + lines) % scroll_height;
+	} else if(lines < 0){
+		// make sure that the value wraps down 
+		t->scroll_value = (scroll_height + t->scroll_value + (lines % scroll_height)) % scroll_height; 
+		// scrolling down - so clear the new lines at the top of the scroll area
+		_vt100_clearLines(t, t->scroll_start_row, t->scroll_start_row+clear-1); 
+	}
+	// the display is only told at the next flush
+	t->screen.scroll_start = t->y + (t->scroll_start_row + t->scroll_value) * VT100_CHAR_HEIGHT; 
+	
+	/*
+	int16_t pixels = lines * VT100_CHAR_HEIGHT;
+	uint16_t scroll_min = t->top_margin * VT100_CHAR_HEIGHT;
+	uint16_t scroll_max = t->bottom_margin * VT100_CHAR_HEIGHT;
+
+	// starting position must be between top and bottom margin
+	// scroll_start == top margin - no scroll at all
+	if(t->scroll >= scroll_min){
+		// clear the top n lines
+		display_fillRect(0, t->scroll, VT100_SCREEN_WIDTH, pixels, 0x0000); 
+		t->scroll += pixels;
+	} else {
+		display_fillRect(0, scroll_min, VT100_SCREEN_WIDTH, pixels, 0x0000); 
+		t->scroll = scroll_min + pixels;
+	}
+	t->scroll = t->scroll % VT100_SCREEN_HEIGHT; 
+	display_setScrollStart(t->scroll);*/
+}
+
+// copies display ram row from over row to. A panel that can move pixels
+// gets the row copied there too (see _vt100_copyRows), otherwise the row
+// is compared against what the panel shows at the next flush.
+void _vt100_moveRow(struct vt100 *t, uint16_t to, uint16_t from){
+	memcpy(t->screen.chars[to], t->screen.chars[from], t->width);
+	memcpy(t->screen.attrs[to], t->screen.attrs[from], t->width);
+#if DISPLAY_COPY
+	memcpy(t->screen.shown_chars[to], t->screen.shown_chars[from], t->width);
+	memcpy(t->screen.shown_attrs[to], t->screen.shown_attrs[from], t->width);
+	if(t->screen.dirty[from >> 3] & _BV(from & 7))
+		_vt100_markDirty(t, to, t->screen.dirty_from[from], t->screen.dirty_to[from]);
+#else
+	_vt100_markDirty(t, to, 0, t->width - 1);
+#endif
+}
+
+#if DISPLAY_COPY
+// moves count display ram rows from row from to row to on the panel
+void _vt100_copyRows(struct vt100 *t, uint16_t to, uint16_t from, uint16_t count){
+	if(!count) return;
+	display_copyRect(t->x, t->y + from * VT100_CHAR_HEIGHT, t->width * VT100_CHAR_WIDTH,
+		count * VT100_CHAR_HEIGHT, t->x, t->y + to * VT100_CHAR_HEIGHT);
+}
+
+// moves the panel up by the lines scrolled since the last flush, in one
+// copy of the region. The rows that came free still show what was there
+// before, they are repainted (filled, usually) by the flush.
+void _vt100_copyScroll(struct vt100 *t){
+	uint8_t lines = t->screen.copy_lines;
+	if(!lines) return;
+	t->screen.copy_lines = 0;
+	int16_t top = t->screen.copy_top, end = t->screen.copy_end;
+	_vt100_copyRows(t, top, top + lines, end - top - lines);
+	for(int16_t row = end - lines; row < end; row++){
+		memset(t->screen.shown_attrs[row], VT100_NO_ATTR, t->width);
+		_vt100_markDirty(t, row, 0, t->width - 1);
+	}
+}
+
+// scrolls the region up without the hardware scroll. The shadow screen
+// moves at once, the panel at the next flush: a stream of new lines costs
+// one copy per frame however many lines it brings.
+void _vt100_scrollUp(struct vt100 *t, int16_t lines){
+	int16_t top = t->scroll_start_row, end = t->scroll_end_row;
+	if(t->screen.copy_lines && (top != t->screen.copy_top || end != t->screen.copy_end))
+		_vt100_copyScroll(t);
+	if(lines > end - top) lines = end - top;
+	for(int16_t row = top; row < end - lines; row++){
+		_vt100_moveRow(t, row, row + lines);
+	}
+	for(int16_t row = end - lines; row < end; row++){
+		_vt100_fillCells(t, row, 0, ' ', VT100_DEFAULT_ATTR, t->width);
+	}
+	t->screen.copy_top = top;
+	t->screen.copy_end = end;
+	lines += t->screen.copy_lines;
+	t->screen.copy_lines = (lines > end - top)?end - top:lines;
+}
+#endif
+
+// inserts (lines > 0) or deletes (lines < 0) lines at screen row top.
+// The rows below it down to the end of the scroll region move and the
+// ones left behind are cleared. Outside of the scroll region it does
+// nothing, like a real vt100.
+void _vt100_shiftRows(struct vt100 *t, int16_t top, int16_t lines){
+	int16_t end = t->scroll_end_row;
+	if(top < t->scroll_start_row || top >= end || !lines) return;
+#if DISPLAY_COPY
+	// the copies below start from what the panel shows
+	_vt100_copyScroll(t);
+#endif
+	if(lines > end - top) lines = end - top;
+	if(lines < top - end) lines = top - end;
+	int16_t moved = end - top - ((lines > 0)?lines:-lines);
+
+	// inserting moves rows down, so start at the bottom. Deleting starts at
+	// the top. Either way no row is overwritten before it was moved.
+	int16_t step = (lines > 0)?-1:1;
+	int16_t row = (lines > 0)?end - 1:top;
+#if DISPLAY_COPY
+	// rows next to each other in display ram are copied in one go
+	uint16_t run_to = 0, run_from = 0, run = 0;
+#endif
+	for(int16_t i = 0; i < moved; i++, row += step){
+		uint16_t to = _vt100_physRow(t, row), from = _vt100_physRow(t, row - lines);
+		_vt100_moveRow(t, to, from);
+#if DISPLAY_COPY
+		if(run && step < 0 && to + 1 == run_to && from + 1 == run_from){
+			run_to = to;
+			run_from = from;
+			run++;
+			continue;
+		}
+		if(run && step > 0 && to == run_to + run && from == run_from + run){
+			run++;
+			continue;
+		}
+		_vt100_copyRows(t, run_to, run_from, run);
+		run_to = to;
+		run_from = from;
+		run = 1;
+#endif
+	}
+#if DISPLAY_COPY
+	_vt100_copyRows(t, run_to, run_from, run);
+#endif
+
+	int16_t clear = (lines > 0)?top:end + lines;
+	for(int16_t c = 0; c < ((lines > 0)?lines:-lines); c++){
+		_vt100_fillCells(t, _vt100_physRow(t, clear + c), 0, ' ', VT100_DEFAULT_ATTR, t->width);
+	}
+}
+
+// moves the cursor relative to current cursor position and scrolls the screen
+void _vt100_move(struct vt100 *term, int16_t right_left, int16_t bottom_top){
+	// calculate how many lines we need to move down or up if x movement goes outside screen
+	int16_t new_x = right_left + term->cursor_x; 
+	if(new_x > term->width){
+		if(term->flags.cursor_wrap){
+			bottom_top += new_x / term->width;
+			term->cursor_x = new_x % term->width - 1;
+		} else {
+			term->cursor_x = term->width;
+		}
+	} else if(new_x < 0){
+		bottom_top += new_x / term->width - 1;
+		term->cursor_x = term->width - (abs(new_x) % term->width) + 1; 
+	} else {
+		term->cursor_x = new_x;
+	}
+
+	if(bottom_top){
+		int16_t new_y = term->cursor_y + bottom_top;
+		int16_t to_scroll = 0;
+		// bottom margin 39 marks last line as static on 40 line display
+		// therefore, we would scroll when new cursor has moved to line 39
+		// (or we could use new_y > VT100_HEIGHT here
+		// NOTE: new_y >= term->scroll_end_row ## to_scroll = (new_y - term->scroll_end_row) +1
+		if(new_y >= term->scroll_end_row){
+			//scroll = new_y / VT100_HEIGHT;
+			//term->cursor_y = VT100_HEIGHT;
+			to_scroll = (new_y - term->scroll_end_row) + 1; 
+			// place cursor back within the scroll region
+			term->cursor_y = term->scroll_end_row - 1; //new_y - to_scroll; 
+			//scroll = new_y - term->bottom_margin; 
+			//term->cursor_y = term->bottom_margin; 
+		} else if(new_y < term->scroll_start_row){
+			to_scroll = (new_y - term->scroll_start_row); 
+			term->cursor_y = term->scroll_start_row; //new_y - to_scroll; 
+			//scroll = new_y / (term->bottom_margin - term->top_margin) - 1;
+			//term->cursor_y = term->top_margin; 
+		} else {
+			// otherwise we move as normal inside the screen
+			term->cursor_y = new_y;
+		}
+		_vt100_scroll(term, to_scroll);
+	}
+}
+
+void _vt100_drawCursor(struct vt100 *t){
+	//uint16_t x = t->cursor_x * t->char_width;
+	//uint16_t y = t->cursor_y * t->char_height;
+
+	//display_fillRect(x, y, t->char_width, t->char_height, t->front_color); 
+	(void)t;
+}
+
+// puts the character on the shadow screen and updates cursor position
+void _vt100_putc(struct vt100 *t, uint8_t ch){
+	if(ch < 0x20 || ch > 0x7e){
+		static const char hex[] = "0123456789abcdef"; 
+		_vt100_putc(t, '0'); 
+		_vt100_putc(t, 'x'); 
+		_vt100_putc(t, hex[((ch & 0xf0) >> 4)]);
+		_vt100_putc(t, hex[(ch & 0x0f)]);
+		return;
+	}
+	
+	_vt100_setCells(t, _vt100_physRow(t, t->cursor_y), t->cursor_x, &ch, t->attr, 1);
+
+	// move cursor right
+	_vt100_move(t, 1, 0); 
+	_vt100_drawCursor(t); 
+}
+
+// puts a run of printable characters that fits on the current row and
+// advances the cursor past it (same result as _vt100_putc() per character)
+void _vt100_putRun(struct vt100 *t, const uint8_t *str, uint8_t len){
+	_vt100_setCells(t, _vt100_physRow(t, t->cursor_y), t->cursor_x, str, t->attr, len);
+
+	t->cursor_x += len;
+	_vt100_drawCursor(t);
+}
+
+// returns numeric argument i, or def if it was omitted or zero
+static inline uint16_t _vt100_arg(struct vt100 *t, uint8_t i, uint16_t def){
+	return (i < t->narg && t->args[i])?t->args[i]:def;
+}
+
+// DEC private modes (ESC [ ? Pn h / ESC [ ? Pn l)
+void _vt100_decMode(struct vt100 *term, uint8_t on){
+	for(uint8_t c = 0; c < term->narg; c++){
+		switch(term->args[c]){
+			case 1: { // cursor keys mode
+				// h = esc 0 A for cursor up
+				// l = cursor keys send ansi commands
+				break;
+			}
+			case 2: { // ansi / vt52
+				// h = ansi mode
+				// l = vt52 mode
+				break;
+			}
+			case 3: {
+				// h = 132 chars per line
+				// l = 80 chars per line
+				break;
+			}
+			case 4: {
+				// h = smooth scroll
+				// l = jump scroll
+				break;
+			}
+			case 5: {
+				// h = black on white bg
+				// l = white on black bg
+				break;
+			}
+			case 6: {
+				// h = cursor relative to scroll region
+				// l = cursor independent of scroll region
+				term->flags.origin_mode = on;
+				break;
+			}
+			case 7: {
+				// h = new line after last column
+				// l = cursor stays at the end of line
+				term->flags.cursor_wrap = on;
+				break;
+			}
+			case 8: {
+				// h = keys will auto repeat
+				// l = keys do not auto repeat when held down
+				break;
+			}
+			case 9: {
+				// h = display interlaced
+				// l = display not interlaced
+				break;
+			}
+			// 10-38 - all quite DEC speciffic commands so omitted here
+#if VT100_ALT_SCREEN
+			case 47:
+			case 1047: {
+				// h = alternate screen
+				// l = main screen
+				_vt100_altScreen(term, on);
+				break;
+			}
+			case 1049: {
+				// h = save cursor, alternate screen and clear it
+				// l = main screen and restore cursor
+				if(on){
+					term->saved_cursor_x = term->cursor_x;
+					term->saved_cursor_y = term->cursor_y;
+					term->saved_attr = term->attr;
+					_vt100_altScreen(term, 1);
+					_vt100_clearLines(term, 0, term->height);
+				} else {
+					_vt100_altScreen(term, 0);
+					term->cursor_x = term->saved_cursor_x;
+					term->cursor_y = term->saved_cursor_y;
+					term->attr = term->saved_attr;
+				}
+				break;
+			}
+#endif
+		}
+	}
+}
+
+// executes a complete control sequence (ESC [ params intermediates final)
+void _vt100_csiDispatch(struct vt100 *term, uint8_t ch){
+	if(term->ninter > MAX_INTERMEDIATES) return;
+	if(term->priv == '?'){
+		switch(ch){
+			case 'h': _vt100_decMode(term, 1); break;
+			case 'l': _vt100_decMode(term, 0); break;
+			case 'n': // status reports, printer status (15) isn't answered
+				switch(_vt100_arg(term, 0, 0)){
+#if VT100_PROFILE
+					case 100: term->tx.dump = profile_line; term->tx.dump_line = 0; break;
+					case 101: profile_init(); break;
+#endif
+					case 102: term->tx.dump = latency_line; term->tx.dump_line = 0; break;
+					case 103: latency_clear(); break;
+				}
+				break;
+			case 'i': /* Printing */
+			default:
+				break;
+		}
+		return;
+	}
+	// no other private or intermediate sequences are supported
+	if(term->priv || term->ninter) return;
+
+	switch(ch){
+		case 'A': {// move cursor up (cursor stops at top margin)
+			term->cursor_y -= _vt100_arg(term, 0, 1);
+			if(term->cursor_y < 0) term->cursor_y = 0; 
+			break;
+		} 
+		case 'B': { // cursor down (cursor stops at bottom margin)
+			term->cursor_y += _vt100_arg(term, 0, 1);
+			if(term->cursor_y > term->height) term->cursor_y = term->height; 
+			break;
+		}
+		case 'C': { // cursor right (cursor stops at right margin)
+			term->cursor_x += _vt100_arg(term, 0, 1);
+			if(term->cursor_x > term->width) term->cursor_x = term->width;
+			break;
+		}
+		case 'D': { // cursor left
+			term->cursor_x -= _vt100_arg(term, 0, 1);
+			if(term->cursor_x < 0) term->cursor_x = 0;
+			break;
+		}
+		case 'f': 
+		case 'H': { // move cursor to position (default 1;1)
+			// cursor stops at respective margins
+			term->cursor_x = _vt100_arg(term, 1, 1) - 1; 
+			term->cursor_y = _vt100_arg(term, 0, 1) - 1;
+			if(term->flags.origin_mode) {
+				term->cursor_y += term->scroll_start_row;
+				if(term->cursor_y >= term->scroll_end_row){
+					term->cursor_y = term->scroll_end_row - 1;
+				}
+			}
+			if(term->cursor_x > term->width) term->cursor_x = term->width;
+			if(term->cursor_y > term->height) term->cursor_y = term->height; 
+			break;
+		}
+		case 'J':{// clear screen from cursor up or down
+			if(term->narg == 0 || (term->narg == 1 && term->args[0] == 0)){
+				// clear down to the bottom of screen (including cursor)
+				_vt100_clearLines(term, term->cursor_y, term->height); 
+			} else if(term->narg == 1 && term->args[0] == 1){
+				// clear top of screen to current line (including cursor)
+				_vt100_clearLines(term, 0, term->cursor_y); 
+			} else if(term->narg == 1 && term->args[0] == 2){
+				// clear whole screen
+				_vt100_clearLines(term, 0, term->height);
+				// reset scroll value
+				_vt100_resetScroll(term); 
+			}
+			break;
+		}
+		case 'K':{// clear line from cursor right/left
+			uint16_t row = _vt100_physRow(term, term->cursor_y);
+			uint8_t blank = VT100_ATTR(7, VT100_ATTR_BG(term->attr));
+
+			if(term->narg == 0 || (term->narg == 1 && term->args[0] == 0)){
+				// clear to end of line (to \n or to edge?)
+				// including cursor
+				_vt100_fillCells(term, row, term->cursor_x, ' ', blank, term->width - term->cursor_x);
+			} else if(term->narg == 1 && term->args[0] == 1){
+				// clear from left to current cursor position
+				_vt100_fillCells(term, row, 0, ' ', blank, term->cursor_x + 1);
+			} else if(term->narg == 1 && term->args[0] == 2){
+				// clear whole current line
+				_vt100_fillCells(term, row, 0, ' ', blank, term->width);
+			}
+			break;
+		}
+		
+		case 'L': // insert lines (args[0] = number of lines)
+		case 'M': { // delete lines (args[0] = number of lines)
+			// more lines than the screen has are as good as all of them
+			int16_t n = _vt100_arg(term, 0, 1);
+			if(n > term->height || n < 0) n = term->height;
+			_vt100_shiftRows(term, term->cursor_y, (ch == 'L')?n:-n);
+			term->cursor_x = 0;
+			break;
+		}
+		case 'P': {// delete characters args[0] or 1 in front of cursor
+			// TODO: this needs to correctly delete n chars
+			int n = _vt100_arg(term, 0, 1);
+			_vt100_move(term, -n, 0);
+			for(int c = 0; c < n; c++){
+				_vt100_putc(term, ' ');
+			}
+			break;
+		}
+		case 'c':{ // query device code
+			_vt100_respond(term, "\e[?1;0c"); 
+			break; 
+		}
+		case 'n':{ // device status report
+			char buf[16];
+			if(_vt100_arg(term, 0, 0) == 5){ // terminal status - always ok
+				_vt100_respond(term, "\e[0n");
+			} else if(_vt100_arg(term, 0, 0) == 6){ // cursor position
+				int16_t row = term->cursor_y + 1, col = term->cursor_x + 1;
+				if(term->flags.origin_mode) row -= term->scroll_start_row;
+				// both are kept on the screen, so the reply is a valid
+				// position and always fits buf
+				if(row < 1) row = 1;
+				if(row > term->height) row = term->height;
+				if(col > term->width) col = term->width;
+				snprintf(buf, sizeof(buf), "\e[%d;%dR", row, col);
+				_vt100_respond(term, buf);
+			}
+			break;
+		}
+		case 'x':{ // request terminal parameters (DECREQTPARM)
+			// no parity, 8 bits, 19200 baud (the fastest a vt100 can report),
+			// bit rate multiplier 16, no switches set
+			if(_vt100_arg(term, 0, 0) == 0) _vt100_respond(term, "\e[2;1;1;120;120;1;0x");
+			else if(term->args[0] == 1) _vt100_respond(term, "\e[3;1;1;120;120;1;0x");
+			break;
+		}
+		case 's':{// save cursor pos
+			term->saved_cursor_x = term->cursor_x;
+			term->saved_cursor_y = term->cursor_y;
+			break;
+		}
+		case 'u':{// restore cursor pos
+			term->cursor_x = term->saved_cursor_x;
+			term->cursor_y = term->saved_cursor_y; 
+			break;
+		}
+		case 'm': { // sets colors
+			// [m means reset the colors to default
+			if(!term->narg){
+				term->attr = VT100_DEFAULT_ATTR;
+			}
+			for(uint8_t c = 0; c < term->narg; c++){
+				int n = term->args[c];
+				if(n == 0){ // all attributes off
+					term->attr = VT100_DEFAULT_ATTR;
+				}
+				if(n >= 30 && n < 38){ // fg colors
+					term->attr = VT100_ATTR(n - 30, VT100_ATTR_BG(term->attr));
+				} else if(n >= 40 && n < 48){
+					term->attr = VT100_ATTR(VT100_ATTR_FG(term->attr), n - 40);
+				}
+			}
+			break;
+		}
+		
+		case 'r': { // Set scroll region (top and bottom margins)
+			// the top value is first row of scroll region, the bottom value
+			// its last row; a missing or zero value means the screen edge and
+			// a host that takes the screen for taller gets it cut to size,
+			// the shadow screen has no rows below its last one
+			uint16_t top = _vt100_arg(term, 0, 1);
+			uint16_t bottom = _vt100_arg(term, 1, term->height);
+			if(bottom > term->height) bottom = term->height;
+			if(top < bottom){
+				// [1;40r means scroll region between 0 and 320
+				// bottom margin is 320 - 40 * 8 = 0 pix
+				// bottom, counted from 1, is the first static row counted from 0
+				if(top - 1 != term->scroll_start_row || bottom != term->scroll_end_row)
+					_vt100_setRegion(term, top - 1, bottom);
+			} else {
+				_vt100_resetScroll(term);
+			}
+			break;
+		}
+
+		case 'q' :  // on-screen LEDS added PS
+			// same as "\r\n" before drawing
+			_vt100_move(term, 0, 1);
+			term->cursor_x = 0; 
+			// LEDs are drawn straight to the display so get the text there first
+			_vt100_flush(term);
+			switch (term->args[0])
+			{ case 0 : display_drawRect(186,6,10,10,DISPLAY_RED,DISPLAY_BLACK);
+					   display_drawRect(200,6,10,10,DISPLAY_RED,DISPLAY_BLACK);
+					   display_drawRect(214,6,10,10,DISPLAY_RED,DISPLAY_BLACK);
+					   display_drawRect(228,6,10,10,DISPLAY_RED,DISPLAY_BLACK);
+					   break;                     
+			  case 1 : display_fillRect(186,6,10,10,DISPLAY_RED); break;
+			  case 2 : display_fillRect(200,6,10,10,DISPLAY_RED); break;
+			  case 3 : display_fillRect(214,6,10,10,DISPLAY_RED); break;
+			  case 4 : display_fillRect(228,6,10,10,DISPLAY_RED); break;
+			  
+			  case 5 : display_drawRect(186,6,10,10,DISPLAY_RED,DISPLAY_BLACK); break;
+			  case 6 : display_drawRect(200,6,10,10,DISPLAY_RED,DISPLAY_BLACK); break;
+			  case 7 : display_drawRect(214,6,10,10,DISPLAY_RED,DISPLAY_BLACK); break;
+			  case 8 : display_drawRect(228,6,10,10,DISPLAY_RED,DISPLAY_BLACK); break;
+			}
+			break;
+		case 'X' : // Baud Rate setting added PS
+			switch (term->args[0])
+			{ case 1 : uart_begin(300); strcpy(new_br,"300   "); break;
+			  case 2 : uart_begin(2400); strcpy(new_br,"2400  "); break;
+			  case 3 : uart_begin(9600); strcpy(new_br,"9600  "); break;
+			  case 4 : uart_begin(57600); strcpy(new_br,"57600 "); break;
+			  case 5 : uart_begin(76800); strcpy(new_br,"76800 "); break;
+			  case 6 : uart_begin(115200); strcpy(new_br,"115200"); break;
+			  // flow control
+			  case 10 : uart_setFlowControl(UART_FLOW_NONE); break;
+			  case 11 : uart_setFlowControl(UART_FLOW_XONXOFF); break;
+			  case 12 : uart_setFlowControl(UART_FLOW_RTSCTS); break;
+			  default : return;
+			}
+			if (term->args[0] < 10)
+			{ EEPROM.update(BAUD_STORE, term->args[0]);
+			  EEPROM.update(BAUD_STORE+1, term->args[0]^0xff);
+			}
+			else
+			{ EEPROM.update(FLOW_STORE, term->args[0]);
+			  EEPROM.update(FLOW_STORE+1, term->args[0]^0xff);
+			}
+			break;  
+
+		case 'h':
+		case 'l':
+		case 'g':
+		case '@': // Insert Characters          
+		case 'i': // Printing  
+		case 'y': // self test modes..
+		default: // unknown sequence
+			break;
+	}
+}
+
+// executes an escape sequence (ESC intermediates final)
+void _vt100_escDispatch(struct vt100 *term, uint8_t ch){
+	if(term->ninter > 1) return;
+	if(term->ninter){
+		switch(term->inter[0]){
+			case '(': /* ESC ( - G0 character set */
+			case ')': /* ESC ) - G1 character set */
+				// translation map commands ('A', 'B', '0', 'O') are ignored
+				break;
+			case '#': /* ESC # */
+				if(ch == '8'){
+					// self test: fill the screen with 'E'
+				}
+				break;
+		}
+		return;
+	}
+	switch(ch){
+		case 'D': // moves cursor down one line and scrolls if necessary
+			// move cursor down one line and scroll window if at bottom line
+			_vt100_move(term, 0, 1); 
+			break; 
+		case 'M': // Cursor up
+			// move cursor up one line and scroll window if at top line
+			_vt100_move(term, 0, -1); 
+			break; 
+		case 'E': // next line
+			// same as '\r\n'
+			_vt100_move(term, 0, 1);
+			term->cursor_x = 0; 
+			break;  
+		case '7': // Save attributes and cursor position  
+			term->saved_cursor_x = term->cursor_x;
+			term->saved_cursor_y = term->cursor_y;
+			term->saved_attr = term->attr;
+			break;  
+		case 's':  
+			term->saved_cursor_x = term->cursor_x;
+			term->saved_cursor_y = term->cursor_y;
+			break;  
+		case '8': // Restore them  
+			term->cursor_x = term->saved_cursor_x;
+			term->cursor_y = term->saved_cursor_y; 
+			term->attr = term->saved_attr; 
+			break; 
+		case 'u': 
+			term->cursor_x = term->saved_cursor_x;
+			term->cursor_y = term->saved_cursor_y; 
+			break; 
+		case 'Z': // Report terminal type 
+			// vt 100 response
+			_vt100_respond(term, "\033[?1;0c");  
+			// unknown terminal     
+				//out("\033[?c");
+			break;    
+		case 'c': // Reset terminal to initial state 
+			_vt100_reset(term);
+			break;  
+		case '=': // Keypad into applications mode 
+		case '>': // Keypad into numeric mode   
+		case 'H': // Set tab in current position 
+		case 'N': // G2 character set for next character only  
+		case 'O': // G3 "               "     
+		case '<': // Exit vt52 mode
+		case '\\': // string terminator
+		default: // unknown sequence
+			// ignore
+			break; 
+	}
+}
+
+// executes a C0 control character
+void _vt100_execute(struct vt100 *term, uint8_t ch){
+	switch(ch){
+		case 5: // AnswerBack for vt100's  
+			_vt100_respond(term, "X"); // should send SCCS_ID?
+			break;  
+		case '\n': { // new line
+			_vt100_move(term, 0, 1);
+			term->cursor_x = 0; 
+			break;
+		}
+		case '\r': { // carrage return (0x0d)
+			term->cursor_x = 0; 
+			break;
+		}
+		case '\b': { // backspace 0x08
+			_vt100_move(term, -1, 0); 
+			// backspace does not delete the character! Only moves cursor!
+			break;
+		}
+		case KEY_DEL: { // del - delete character under cursor
+			// Problem: with current implementation, we can't move the rest of line
+			// to the left as is the proper behavior of the delete character
+			// fill the current position with background color
+			_vt100_putc(term, ' ');
+			_vt100_move(term, -1, 0);
+			break;
+		}
+		case '\t': { // tab
+			// tab fills characters on the line until we reach a multiple of tab_stop
+			int tab_stop = 4;
+			int to_put = tab_stop - (term->cursor_x % tab_stop); 
+			while(to_put--) _vt100_putc(term, ' ');
+			break;
+		}
+		case KEY_BELL: { // bell is sent by bash for ex. when doing tab completion
+			// sound the speaker bell?
+			// skip
+			break; 
+		}
+		default: // other controls are shown as hex
+			_vt100_putc(term, ch);
+			break;
+	}
+}
+
+// parser is a DEC compatible state machine (after Paul Williams' vt100 parser).
+// Every byte is first mapped to a class, then the state x class table gives
+// the action to run and the next state, packed as (action << 4) | state.
+#define T(ACTION, STATE) (((ACTION) << 4) | (STATE))
+
+static const uint8_t _vt100_class[256] PROGMEM = {
+	// 0x00 - 0x1f: C0 controls
+	CL_C0, CL_C0, CL_C0, CL_C0, CL_C0, CL_C0, CL_C0, CL_BEL,
+	CL_C0, CL_C0, CL_C0, CL_C0, CL_C0, CL_C0, CL_C0, CL_C0,
+	CL_C0, CL_C0, CL_C0, CL_C0, CL_C0, CL_C0, CL_C0, CL_C0,
+	CL_CAN, CL_C0, CL_CAN, CL_ESC, CL_C0, CL_C0, CL_C0, CL_C0,
+	// 0x20 - 0x2f: intermediates
+	CL_INTER, CL_INTER, CL_INTER, CL_INTER, CL_INTER, CL_INTER, CL_INTER, CL_INTER,
+	CL_INTER, CL_INTER, CL_INTER, CL_INTER, CL_INTER, CL_INTER, CL_INTER, CL_INTER,
+	// 0x30 - 0x3f: parameters and private markers
+	CL_DIGIT, CL_DIGIT, CL_DIGIT, CL_DIGIT, CL_DIGIT, CL_DIGIT, CL_DIGIT, CL_DIGIT,
+	CL_DIGIT, CL_DIGIT, CL_COLON, CL_SEMI, CL_PRIV, CL_PRIV, CL_PRIV, CL_PRIV,
+	// 0x40 - 0x7e: final bytes, 0x7f: DEL
+	CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL,
+	CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL,
+	CL_STRING, CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL,
+	CL_STRING, CL_FINAL, CL_FINAL, CL_CSI, CL_FINAL, CL_STRING, CL_STRING, CL_STRING,
+	CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL,
+	CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL,
+	CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL,
+	CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL, CL_FINAL, CL_DEL,
+	// 0x80 - 0xff: shown as hex by _vt100_putc()
+	CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH,
+	CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH,
+	CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH,
+	CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH,
+	CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH,
+	CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH,
+	CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH,
+	CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH,
+	CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH,
+	CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH,
+	CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH,
+	CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH,
+	CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH,
+	CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH,
+	CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH,
+	CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH, CL_HIGH
+};
+
+static const uint8_t _vt100_table[STATE_COUNT][CL_COUNT] PROGMEM = {
+	{ // STATE_GROUND
+		T(ACT_EXECUTE, STATE_GROUND), // C0
+		T(ACT_EXECUTE, STATE_GROUND), // BEL
+		T(ACT_EXECUTE, STATE_GROUND), // CAN
+		T(ACT_CLEAR, STATE_ESCAPE), // ESC
+		T(ACT_PRINT, STATE_GROUND), // 0x20-0x2f
+		T(ACT_PRINT, STATE_GROUND), // 0-9
+		T(ACT_PRINT, STATE_GROUND), // ':'
+		T(ACT_PRINT, STATE_GROUND), // ';'
+		T(ACT_PRINT, STATE_GROUND), // <=>?
+		T(ACT_PRINT, STATE_GROUND), // '['
+		T(ACT_PRINT, STATE_GROUND), // P ] X ^ _
+		T(ACT_PRINT, STATE_GROUND), // final
+		T(ACT_EXECUTE, STATE_GROUND), // DEL
+		T(ACT_PRINT, STATE_GROUND)  // 0x80-0xff
+	},
+	{ // STATE_ESCAPE
+		T(ACT_EXECUTE, STATE_ESCAPE), // C0
+		T(ACT_EXECUTE, STATE_ESCAPE), // BEL
+		T(ACT_NONE, STATE_GROUND), // CAN
+		T(ACT_CLEAR, STATE_ESCAPE), // ESC
+		T(ACT_COLLECT, STATE_ESC_INTER), // 0x20-0x2f
+		T(ACT_ESC_DISPATCH, STATE_GROUND), // 0-9
+		T(ACT_ESC_DISPATCH, STATE_GROUND), // ':'
+		T(ACT_ESC_DISPATCH, STATE_GROUND), // ';'
+		T(ACT_ESC_DISPATCH, STATE_GROUND), // <=>?
+		T(ACT_CLEAR, STATE_CSI_ENTRY), // '['
+		T(ACT_NONE, STATE_STRING), // P ] X ^ _
+		T(ACT_ESC_DISPATCH, STATE_GROUND), // final
+		T(ACT_NONE, STATE_ESCAPE), // DEL
+		T(ACT_NONE, STATE_GROUND)  // 0x80-0xff
+	},
+	{ // STATE_ESC_INTER
+		T(ACT_EXECUTE, STATE_ESC_INTER), // C0
+		T(ACT_EXECUTE, STATE_ESC_INTER), // BEL
+		T(ACT_NONE, STATE_GROUND), // CAN
+		T(ACT_CLEAR, STATE_ESCAPE), // ESC
+		T(ACT_COLLECT, STATE_ESC_INTER), // 0x20-0x2f
+		T(ACT_ESC_DISPATCH, STATE_GROUND), // 0-9
+		T(ACT_ESC_DISPATCH, STATE_GROUND), // ':'
+		T(ACT_ESC_DISPATCH, STATE_GROUND), // ';'
+		T(ACT_ESC_DISPATCH, STATE_GROUND), // <=>?
+		T(ACT_ESC_DISPATCH, STATE_GROUND), // '['
+		T(ACT_ESC_DISPATCH, STATE_GROUND), // P ] X ^ _
+		T(ACT_ESC_DISPATCH, STATE_GROUND), // final
+		T(ACT_NONE, STATE_ESC_INTER), // DEL
+		T(ACT_NONE, STATE_GROUND)  // 0x80-0xff
+	},
+	{ // STATE_CSI_ENTRY
+		T(ACT_EXECUTE, STATE_CSI_ENTRY), // C0
+		T(ACT_EXECUTE, STATE_CSI_ENTRY), // BEL
+		T(ACT_NONE, STATE_GROUND), // CAN
+		T(ACT_CLEAR, STATE_ESCAPE), // ESC
+		T(ACT_COLLECT, STATE_CSI_INTER), // 0x20-0x2f
+		T(ACT_PARAM, STATE_CSI_PARAM), // 0-9
+		T(ACT_NONE, STATE_CSI_IGNORE), // ':'
+		T(ACT_PARAM, STATE_CSI_PARAM), // ';'
+		T(ACT_COLLECT, STATE_CSI_PARAM), // <=>?
+		T(ACT_CSI_DISPATCH, STATE_GROUND), // '['
+		T(ACT_CSI_DISPATCH, STATE_GROUND), // P ] X ^ _
+		T(ACT_CSI_DISPATCH, STATE_GROUND), // final
+		T(ACT_NONE, STATE_CSI_ENTRY), // DEL
+		T(ACT_NONE, STATE_GROUND)  // 0x80-0xff
+	},
+	{ // STATE_CSI_PARAM
+		T(ACT_EXECUTE, STATE_CSI_PARAM), // C0
+		T(ACT_EXECUTE, STATE_CSI_PARAM), // BEL
+		T(ACT_NONE, STATE_GROUND), // CAN
+		T(ACT_CLEAR, STATE_ESCAPE), // ESC
+		T(ACT_COLLECT, STATE_CSI_INTER), // 0x20-0x2f
+		T(ACT_PARAM, STATE_CSI_PARAM), // 0-9
+		T(ACT_NONE, STATE_CSI_IGNORE), // ':'
+		T(ACT_PARAM, STATE_CSI_PARAM), // ';'
+		T(ACT_NONE, STATE_CSI_IGNORE), // <=>?
+		T(ACT_CSI_DISPATCH, STATE_GROUND), // '['
+		T(ACT_CSI_DISPATCH, STATE_GROUND), // P ] X ^ _
+		T(ACT_CSI_DISPATCH, STATE_GROUND), // final
+		T(ACT_NONE, STATE_CSI_PARAM), // DEL
+		T(ACT_NONE, STATE_GROUND)  // 0x80-0xff
+	},
+	{ // STATE_CSI_INTER
+		T(ACT_EXECUTE, STATE_CSI_INTER), // C0
+		T(ACT_EXECUTE, STATE_CSI_INTER), // BEL
+		T(ACT_NONE, STATE_GROUND), // CAN
+		T(ACT_CLEAR, STATE_ESCAPE), // ESC
+		T(ACT_COLLECT, STATE_CSI_INTER), // 0x20-0x2f
+		T(ACT_NONE, STATE_CSI_IGNORE), // 0-9
+		T(ACT_NONE, STATE_CSI_IGNORE), // ':'
+		T(ACT_NONE, STATE_CSI_IGNORE), // ';'
+		T(ACT_NONE, STATE_CSI_IGNORE), // <=>?
+		T(ACT_CSI_DISPATCH, STATE_GROUND), // '['
+		T(ACT_CSI_DISPATCH, STATE_GROUND), // P ] X ^ _
+		T(ACT_CSI_DISPATCH, STATE_GROUND), // final
+		T(ACT_NONE, STATE_CSI_INTER), // DEL
+		T(ACT_NONE, STATE_GROUND)  // 0x80-0xff
+	},
+	{ // STATE_CSI_IGNORE
+		T(ACT_EXECUTE, STATE_CSI_IGNORE), // C0
+		T(ACT_EXECUTE, STATE_CSI_IGNORE), // BEL
+		T(ACT_NONE, STATE_GROUND), // CAN
+		T(ACT_CLEAR, STATE_ESCAPE), // ESC
+		T(ACT_NONE, STATE_CSI_IGNORE), // 0x20-0x2f
+		T(ACT_NONE, STATE_CSI_IGNORE), // 0-9
+		T(ACT_NONE, STATE_CSI_IGNORE), // ':'
+		T(ACT_NONE, STATE_CSI_IGNORE), // ';'
+		T(ACT_NONE, STATE_CSI_IGNORE), // <=>?
+		T(ACT_NONE, STATE_GROUND), // '['
+		T(ACT_NONE, STATE_GROUND), // P ] X ^ _
+		T(ACT_NONE, STATE_GROUND), // final
+		T(ACT_NONE, STATE_CSI_IGNORE), // DEL
+		T(ACT_NONE, STATE_GROUND)  // 0x80-0xff
+	},
+	{ // STATE_STRING - DCS, OSC, SOS, PM and APC strings are swallowed
+		T(ACT_NONE, STATE_STRING), // C0
+		T(ACT_NONE, STATE_GROUND), // BEL (xterm style OSC terminator)
+		T(ACT_NONE, STATE_GROUND), // CAN
+		T(ACT_CLEAR, STATE_ESCAPE), // ESC (ESC \ is the string terminator)
+		T(ACT_NONE, STATE_STRING), // 0x20-0x2f
+		T(ACT_NONE, STATE_STRING), // 0-9
+		T(ACT_NONE, STATE_STRING), // ':'
+		T(ACT_NONE, STATE_STRING), // ';'
+		T(ACT_NONE, STATE_STRING), // <=>?
+		T(ACT_NONE, STATE_STRING), // '['
+		T(ACT_NONE, STATE_STRING), // P ] X ^ _
+		T(ACT_NONE, STATE_STRING), // final
+		T(ACT_NONE, STATE_STRING), // DEL
+		T(ACT_NONE, STATE_STRING)  // 0x80-0xff
+	}
+};
+#undef T
+
+// runs one byte through the state machine
+void _vt100_feed(struct vt100 *t, uint8_t ch){
+	PROFILE_START(start);
+	uint8_t state = t->state;
+	uint8_t tr = pgm_read_byte(&_vt100_table[state][pgm_read_byte(&_vt100_class[ch])]);
+	t->state = tr & 0x0f;
+
+	switch(tr >> 4){
+		case ACT_PRINT:
+			_vt100_putc(t, ch);
+			break;
+		case ACT_EXECUTE: {
+			PROFILE_START(dispatch);
+			_vt100_execute(t, ch);
+			PROFILE_END(PROFILE_EXECUTE, dispatch);
+			break;
+		}
+		case ACT_CLEAR:
+			t->narg = 0;
+			t->ninter = 0;
+			t->priv = 0;
+			for(int c = 0; c < MAX_COMMAND_ARGS; c++)
+				t->args[c] = 0;
+			break;
+		case ACT_COLLECT:
+			if(ch >= 0x3c){
+				t->priv = ch;
+			} else {
+				if(t->ninter < MAX_INTERMEDIATES) t->inter[t->ninter] = ch;
+				if(t->ninter <= MAX_INTERMEDIATES) t->ninter++;
+			}
+			break;
+		case ACT_PARAM:
+			// narg keeps counting past MAX_COMMAND_ARGS so extra
+			// parameters are dropped instead of merged into the last one
+			if(!t->narg) t->narg = 1;
+			if(ch == ';'){
+				if(t->narg <= MAX_COMMAND_ARGS) t->narg++;
+			} else if(t->narg <= MAX_COMMAND_ARGS){
+				uint16_t *arg = &t->args[t->narg - 1];
+				if(*arg < 6553) *arg = *arg * 10 + (ch - '0');
+			}
+			break;
+		case ACT_ESC_DISPATCH: {
+			PROFILE_START(dispatch);
+			_vt100_escDispatch(t, ch);
+			PROFILE_END(PROFILE_ESC_DISPATCH, dispatch);
+			break;
+		}
+		case ACT_CSI_DISPATCH: {
+			if(t->narg > MAX_COMMAND_ARGS) t->narg = MAX_COMMAND_ARGS;
+			PROFILE_START(dispatch);
+			_vt100_csiDispatch(t, ch);
+			PROFILE_END(PROFILE_CSI_DISPATCH, dispatch);
+			break;
+		}
+	}
+	PROFILE_END(PROFILE_GROUND + state, start);
+}
+
+struct vt100 *vt100_init(uint8_t n){
+	static uint8_t started;
+	if(n >= VT100_INSTANCES) return 0;
+	struct vt100 *t = &terms[n];
+	// the profile and latency counters are shared by all terminals, so
+	// only the first one set up starts them
+	if(!started){
+#if VT100_PROFILE
+		profile_init();
+#endif
+		latency_clear();
+		started = 1;
+	}
+	t->screen.skipped = 0;
+	t->tx.dump = 0;
+	vt100_setViewport(t, 0, 0, VT100_WIDTH, VT100_HEIGHT, 1);
+	return t;
+}
+
+void vt100_setViewport(struct vt100 *t, uint16_t x, uint16_t y, uint8_t cols, uint8_t rows, uint8_t hw_scroll){
+	if(cols > VT100_MAX_WIDTH) cols = VT100_MAX_WIDTH;
+	if(rows > VT100_MAX_HEIGHT) rows = VT100_MAX_HEIGHT;
+#if VT100_ALT_SCREEN
+	// leave the alternate screen where it was drawn
+	if(t->flags.alt_screen) _vt100_altScreen(t, 0);
+#endif
+	// the rows go back in order while they are where the old viewport had
+	// them, and are repainted below
+	uint8_t scrolled = t->scroll_value != 0;
+	_vt100_unscroll(t);
+#if DISPLAY_COPY
+	_vt100_copyScroll(t);
+#endif
+	t->x = x;
+	t->y = y;
+	t->width = cols;
+	t->height = rows;
+	t->flags.whole_panel = !x && !y && cols == VT100_WIDTH && rows == VT100_HEIGHT;
+	// the scroll window goes right across the panel and has one owner, a
+	// terminal that had it scrolls in software from now on
+	t->flags.hw_scroll = DISPLAY_SCROLL && hw_scroll && !x && cols == VT100_WIDTH;
+	for(uint8_t i = 0; t->flags.hw_scroll && i < VT100_INSTANCES; i++){
+		struct vt100 *other = &terms[i];
+		if(other == t || !other->flags.hw_scroll) continue;
+		// its rows back in order, repainted where display ram differs
+		_vt100_unscroll(other);
+		other->flags.hw_scroll = 0;
+	}
+
+	memset(t->screen.shown_attrs, VT100_NO_ATTR, sizeof(t->screen.shown_attrs));
+	memset(t->screen.dirty, 0, sizeof(t->screen.dirty));
+	t->screen.shown_scroll_start = 0xffff;
+#if VT100_ALT_SCREEN
+	// the alternate screen starts out blank and unscrolled
+	memset(t->hidden.chars, ' ', sizeof(t->hidden.chars));
+	memset(t->hidden.attrs, VT100_DEFAULT_ATTR, sizeof(t->hidden.attrs));
+#if DISPLAY_LAYERS > 1
+	memset(t->hidden.shown_attrs, VT100_NO_ATTR, sizeof(t->hidden.shown_attrs));
+	t->hidden.shown_scroll_start = 0xffff;
+#endif
+	t->hidden.scroll_start = y;
+	t->hidden.scroll_start_row = 0;
+	t->hidden.scroll_end_row = rows;
+	t->hidden.scroll_value = 0;
+#endif
+	t->screen.stamped = 0;
+	t->screen.skipping = 0;
+	_vt100_reset(t); 
+	for(uint16_t row = 0; scrolled && row < t->height; row++){
+		_vt100_markDirty(t, row, 0, t->width - 1);
+	}
+}
+
+// sets how often streamed input is repainted. 0 repaints after every
+// vt100_putc()/vt100_write(), otherwise the screen is only updated hz times
+// a second and vt100_flush() should be called when the input goes idle.
+void vt100_setRefreshRate(struct vt100 *t, uint8_t hz){
+	t->screen.frame_ms = hz?(1000 / hz):0;
+}
+
+// the next vt100_write() holds a byte that came in at micros() arrived.
+// Only one byte is timed per repaint, the one that has waited longest.
+void vt100_stamp(struct vt100 *t, uint32_t arrived){
+	if(t->screen.stamped) return;
+	t->screen.stamp = arrived;
+	t->screen.stamped = 1;
+}
+
+// waiting is how many input bytes are queued behind the next
+// vt100_write(). Repaints stop above VT100_SKIP_ON and start again at
+// VT100_SKIP_OFF, in between the last state holds so a backlog hovering
+// around one mark doesn't flicker between the two.
+void vt100_setBacklog(struct vt100 *t, uint16_t waiting){
+	if(waiting > VT100_SKIP_ON) t->screen.skipping = 1;
+	else if(waiting <= VT100_SKIP_OFF) t->screen.skipping = 0;
+}
+
+uint8_t vt100_skipping(struct vt100 *t){
+	return t->screen.skipping;
+}
+
+// input bytes taken in while repaints were held off
+uint32_t vt100_skipped(struct vt100 *t){
+	return t->screen.skipped;
+}
+
+// the display list goes out once per frame, repaints in between (alternate
+// screen, LEDs) only add to it. Asking for a repaint ends skipping.
+void vt100_flush(struct vt100 *t){
+	t->screen.skipping = 0;
+	_vt100_flush(t);
+	display_flush();
+	t->screen.flushed_at = millis();
+}
+
+// returns how many reply bytes can be read from *data in one piece.
+// The caller sends what its port will take without blocking and hands
+// that count to vt100_txConsume().
+size_t vt100_txChunk(struct vt100 *t, const uint8_t **data){
+	// tables go out a line at a time, whenever the queue is empty
+	if(t->tx.dump && t->tx.head == t->tx.tail){
+		char line[VT100_TX_SIZE];
+		if(t->tx.dump(t->tx.dump_line++, line, sizeof(line))) _vt100_respond(t, line);
+		else t->tx.dump = 0;
+	}
+	*data = &t->tx.buf[t->tx.tail];
+	if(t->tx.head >= t->tx.tail) return t->tx.head - t->tx.tail;
+	return VT100_TX_SIZE - t->tx.tail;
+}
+
+void vt100_txConsume(struct vt100 *t, size_t len){
+	t->tx.tail = (t->tx.tail + len) & TX_MASK;
+}
+
+// called after streamed input: repaints unless we are inside a frame or
+// behind on the input
+void _vt100_frameDone(struct vt100 *t){
+	if(t->screen.skipping) return;
+	if(!t->screen.frame_ms || millis() - t->screen.flushed_at >= t->screen.frame_ms){
+		vt100_flush(t);
+	}
+}
+
+void vt100_write(struct vt100 *t, const uint8_t *buf, size_t len){
+	if(t->screen.skipping) t->screen.skipped += len;
+	while(len){
+		// in idle state scan ahead for printable characters and draw as many
+		// of them as fit on the current row in one address window
+		if(t->state == STATE_GROUND && *buf >= 0x20 && *buf <= 0x7e){
+			int16_t room = t->width - t->cursor_x;
+			size_t n = 0;
+			while(n < len && (int16_t)n < room && buf[n] >= 0x20 && buf[n] <= 0x7e) n++;
+			if(n){
+				PROFILE_START(start);
+				_vt100_putRun(t, buf, n);
+				PROFILE_END(PROFILE_PRINT_RUN, start);
+				buf += n;
+				len -= n;
+				continue;
+			}
+		}
+		_vt100_feed(t, *buf++);
+		len--;
+	}
+	_vt100_frameDone(t);
+}
+
+// repaints every cell from the shadow screen, e.g. after a rotation
+void vt100_redraw(struct vt100 *t){
+	memset(t->screen.shown_attrs, VT100_NO_ATTR, sizeof(t->screen.shown_attrs));
+	for(uint16_t row = 0; row < t->height && row < VT100_MAX_HEIGHT; row++){
+		_vt100_markDirty(t, row, 0, t->width - 1);
+	}
+	_vt100_flush(t);
+	display_flush();
+}
+
+void vt100_putc(struct vt100 *t, uint8_t c){
+	/*char *buffer = 0; 
+	switch(c){
+		case KEY_UP:         buffer="\e[A";    break;
+		case KEY_DOWN:       buffer="\e[B";    break;
+		case KEY_RIGHT:      buffer="\e[C";    break;
+		case KEY_LEFT:       buffer="\e[D";    break;
+		case KEY_BACKSPACE:  buffer="\b";      break;
+		case KEY_IC:         buffer="\e[2~";   break;
+		case KEY_DC:         buffer="\e[3~";   break;
+		case KEY_HOME:       buffer="\e[7~";   break;
+		case KEY_END:        buffer="\e[8~";   break;
+		case KEY_PPAGE:      buffer="\e[5~";   break;
+		case KEY_NPAGE:      buffer="\e[6~";   break;
+		case KEY_SUSPEND:    buffer="\x1A";    break;      // ctrl-z
+		case KEY_F(1):       buffer="\e[[A";   break;
+		case KEY_F(2):       buffer="\e[[B";   break;
+		case KEY_F(3):       buffer="\e[[C";   break;
+		case KEY_F(4):       buffer="\e[[D";   break;
+		case KEY_F(5):       buffer="\e[[E";   break;
+		case KEY_F(6):       buffer="\e[17~";  break;
+		case KEY_F(7):       buffer="\e[18~";  break;
+		case KEY_F(8):       buffer="\e[19~";  break;
+		case KEY_F(9):       buffer="\e[20~";  break;
+		case KEY_F(10):      buffer="\e[21~";  break;
+	}
+	if(buffer){
+		while(*buffer){
+			_vt100_feed(t, *buffer++);
+		}
+	} else {
+		_vt100_feed(t, c);
+	}*/
+	if(t->screen.skipping) t->screen.skipped++;
+	_vt100_feed(t, c);
+	_vt100_frameDone(t);
+}
+
+void vt100_puts(struct vt100 *t, const char *str){
+	while(*str){
+		_vt100_feed(t, *str++);
+	}
+	vt100_flush(t);
+}
@@ -1,32 +1,95 @@
-/**
-	This file is part of FORTMAX kernel.
-
-	FORTMAX kernel is free software: you can redistribute it and/or modify
-	it under the terms of the GNU General Public License as published by
-	the Free Software Foundation, either version 3 of the License, or
-	(at your option) any later version.
-
-	FORTMAX kernel is distributed in the hope that it will be useful,
-	but WITHOUT ANY WARRANTY; without even the implied warranty of
-	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-	GNU General Public License for more details.
-
-	You should have received a copy of the GNU General Public License
-	along with FORTMAX kernel.  If not, see <http://www.gnu.org/licenses/>.
-
-	Copyright: Martin K. Schröder (info@fortmax.se) 2014
-*/
-
-#define VT100_SCREEN_WIDTH ili9340_width()
-#define VT100_SCREEN_HEIGHT ili9340_height()
-#define VT100_CHAR_WIDTH 6
-#define VT100_CHAR_HEIGHT 8
-#define VT100_HEIGHT (VT100_SCREEN_HEIGHT / VT100_CHAR_HEIGHT)
-#define VT100_WIDTH (VT100_SCREEN_WIDTH / VT100_CHAR_WIDTH)
-
-#define BAUD_STORE 4
-
-void vt100_init(void (*send_response)(char *str)); 
-void vt100_putc(uint8_t ch);
-void vt100_puts(const char *str);
-
+/**
+	This file is part of FORTMAX kernel.
+
+	FORTMAX kernel is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	FORTMAX kernel is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with FORTMAX kernel.  If not, see <http://www.gnu.org/licenses/>.
+
+	Copyright: Martin K. Schröder (info@fortmax.se) 2014
+*/
+
+#define VT100_SCREEN_WIDTH display_width()
+#define VT100_SCREEN_HEIGHT display_height()
+#define VT100_CHAR_WIDTH DISPLAY_CHAR_WIDTH
+#define VT100_CHAR_HEIGHT DISPLAY_CHAR_HEIGHT
+#define VT100_HEIGHT (VT100_SCREEN_HEIGHT / VT100_CHAR_HEIGHT)
+#define VT100_WIDTH (VT100_SCREEN_WIDTH / VT100_CHAR_WIDTH)
+// largest text size over all rotations, used to size the shadow screen
+#define VT100_MAX_WIDTH (DISPLAY_MAX_WIDTH / VT100_CHAR_WIDTH)
+#define VT100_MAX_HEIGHT (DISPLAY_MAX_HEIGHT / VT100_CHAR_HEIGHT)
+
+#define BAUD_STORE 4
+#define FLOW_STORE (BAUD_STORE + 2)
+
+// size of the queue for replies to the host, must be a power of two
+#ifndef VT100_TX_SIZE
+#define VT100_TX_SIZE 64
+#endif
+
+// alternate screen (DEC modes 47, 1047 and 1049) for full screen programs.
+// It needs a second shadow screen, which the AVR has no RAM for.
+#ifndef VT100_ALT_SCREEN
+#if defined(__AVR__)
+#define VT100_ALT_SCREEN 0
+#else
+#define VT100_ALT_SCREEN 1
+#endif
+#endif
+
+// jump scroll: while more than VT100_SKIP_ON bytes wait behind the input
+// given to vt100_write() nothing is repainted, the screen is only kept up
+// in memory. Once no more than VT100_SKIP_OFF wait the final state goes
+// out in one repaint. Keep VT100_SKIP_ON below the point where flow control
+// holds off the host, or the backlog never gets that far.
+#ifndef VT100_SKIP_ON
+#define VT100_SKIP_ON 512
+#endif
+#ifndef VT100_SKIP_OFF
+#define VT100_SKIP_OFF 0
+#endif
+
+// terminals that can run at once, each with its own parser, shadow screen
+// and replies, drawn into its own viewport of the one panel. Every one
+// costs a shadow screen (and an alternate one) of VT100_MAX_WIDTH x
+// VT100_MAX_HEIGHT cells.
+//#define VT100_INSTANCES 3 // vt_test.ino with SPLIT_SCREEN
+
+#ifndef VT100_INSTANCES
+#define VT100_INSTANCES 1
+#endif
+
+struct vt100;
+
+// resets terminal n (below VT100_INSTANCES) to fill the whole panel, with
+// the hardware scroll, and returns it. 0 for a terminal that doesn't exist.
+// That takes the panel's scroll window back, so set up all terminals
+// before giving them their viewports. The first call also zeroes the
+// profile and latency counters, which all terminals share.
+struct vt100 *vt100_init(uint8_t n);
+// moves the terminal to cols x rows characters with the top left corner
+// at pixel (x, y) and resets it. Only one terminal can have the hardware
+// scroll (hw_scroll), and only with a viewport the width of the panel, the
+// others scroll in software; the one that had it loses it. Panels without a scroll window (DISPLAY_SCROLL
+// in display.h) ignore hw_scroll.
+void vt100_setViewport(struct vt100 *t, uint16_t x, uint16_t y, uint8_t cols, uint8_t rows, uint8_t hw_scroll);
+void vt100_putc(struct vt100 *t, uint8_t ch);
+void vt100_write(struct vt100 *t, const uint8_t *buf, size_t len);
+void vt100_puts(struct vt100 *t, const char *str);
+void vt100_redraw(struct vt100 *t);
+void vt100_setRefreshRate(struct vt100 *t, uint8_t hz);
+void vt100_flush(struct vt100 *t);
+void vt100_stamp(struct vt100 *t, uint32_t arrived);
+void vt100_setBacklog(struct vt100 *t, uint16_t waiting);
+uint8_t vt100_skipping(struct vt100 *t);
+uint32_t vt100_skipped(struct vt100 *t);
+size_t vt100_txChunk(struct vt100 *t, const uint8_t **data);
+void vt100_txConsume(struct vt100 *t, size_t len);
@@ -1,106 +1,340 @@
-
-// A FAST subset-VT100 serial terminal with 40 lines by 40 chars
-
-#include <avr/io.h>
-#include <avr/interrupt.h>
-#include <util/delay.h>
-#include <string.h>
-#include <stdarg.h>
-#include <ctype.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <EEPROM.h>
-
-/**  
-  VT-100 code Copyright: Martin K. Schröder (info@fortmax.se) 2014/10/27
-  Conversion to Arduino, additional codes and this page by Peter Scargill 2016
-*/
-
-#include "ili9340.h"
-#include "vt100.h"
-
-extern char new_br[8]; // baud-rate string - if non-zero will update screen
-uint32_t charCounter=0;
-uint32_t charShadow=0;
-uint8_t  charStart=1;
-
-void setup() {
-  Serial.begin(115200);
-  Serial1.begin(115200);  
-  ili9340_init();
-  ili9340_setRotation(0);  
-}
-
-#define PURPLE_ON_BLACK "\e[35;40m"
-#define GREEN_ON_BLACK "\e[32;40m"
-
-void loop() {
-  auto respond = [=](char *str){ Serial.print(str); }; 
-  vt100_init(respond);
-  sei();
- 
-  // reset terminal and clear screen..
-  vt100_puts("\e[c");   // terminal ok
-  vt100_puts("\e[2J");  // erase entire screen
-  vt100_puts("\e[?6l"); // absolute origin
-  // print some fixed purple text top and bottom
-  vt100_puts(PURPLE_ON_BLACK);   
-  vt100_puts("\e[2;1HSerial HC2016 Terminal 1.0"); 
-  vt100_puts("\e[39;1HBaud: 115200");
-  vt100_puts("\e[39;15HChars:");
-  // 4 LEDS in the top corner initially set to OFF
-  ili9340_drawRect(186,6,10,10,ILI9340_RED,ILI9340_BLACK);
-  ili9340_drawRect(200,6,10,10,ILI9340_RED,ILI9340_BLACK);
-  ili9340_drawRect(214,6,10,10,ILI9340_RED,ILI9340_BLACK);
-  ili9340_drawRect(228,6,10,10,ILI9340_RED,ILI9340_BLACK);
-  // delimit fixed areas
-  ili9340_drawFastHLine(0,20, 240, ILI9340_BLUE);
-  ili9340_drawFastHLine(0,300, 240, ILI9340_RED);
-  vt100_puts("\e[4;38r"); // set the scrolling region
-  vt100_puts(GREEN_ON_BLACK);
-  vt100_puts("\e[37;1H"); // Set up at line 37, char position 1
-  vt100_puts("\e[0q"); // All top corner LEDs off
-
-  if ((EEPROM.read(BAUD_STORE)^EEPROM.read(BAUD_STORE+1))==0xff)
-  {
-    char bStr[12];
-    sprintf(bStr,"\e[%dX",EEPROM.read(BAUD_STORE));
-    vt100_puts(bStr);
-  }
-  else vt100_puts("\e[6X"); // baud rate 6 - i.e. 115200
- 
-  while(1){
-    char data;
-    data=Serial.read();
-    if(data == -1) 
-      {
-      data=Serial1.read();
-      if(data == -1) 
-          {   
-          //if nothing coming in serial - check for baud rate message
-          if (new_br[0]) 
-              { 
-                vt100_puts("\e7\e[39;7H"); // save cursor and attribs
-                vt100_puts(PURPLE_ON_BLACK);
-                vt100_puts(new_br); 
-                vt100_puts("\e8"); // restore cursor and attribs
-                new_br[0]=0; 
-               } 
-          //or character count update
-          if ((charCounter!=charShadow) || (charStart))
-            {
-              charShadow=charCounter; charStart=0;
-              vt100_puts("\e7");  //save cursor and color
-              vt100_puts(PURPLE_ON_BLACK);
-              char numbers[12]; sprintf(numbers,"%ld",charCounter); 
-              vt100_puts("\e[39;22H"); vt100_puts(numbers);          
-              vt100_puts("\e8");  //restore cursor and attribs                
-            }
-            continue;
-          }
-      }
-    charCounter++;
-    vt100_putc(data);  
-  }
-}
-
+
+// A FAST subset-VT100 serial terminal with 40 lines by 40 chars
+
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <EEPROM.h>
+
+/**  
+  VT-100 code Copyright: Martin K. Schröder (info@fortmax.se) 2014/10/27
+  Conversion to Arduino, additional codes and this page by Peter Scargill 2016
+*/
+
+#include "display.h"
+#include "vt100.h"
+#include "uart.h"
+#include "latency.h"
+
+extern char new_br[8]; // baud-rate string - if non-zero will update screen
+uint32_t charCounter=0;
+uint32_t charShadow=0;
+uint8_t  charStart=1;
+uint16_t highShadow=0;
+uint32_t overrunShadow=0;
+uint32_t latencyShadow=0;
+uint8_t  skipShadow=0;
+uint32_t skippedShadow=0;
+// the terminal with the status rows, across the whole panel, and the ones
+// each port feeds. Without SPLIT_SCREEN they are all the same.
+struct vt100 *term, *uartTerm, *usbTerm;
+
+void setup() {
+  Serial.begin(115200);
+  uart_begin(115200);  
+  display_init();
+  display_setRotation(0);  
+#if VT100_PIPELINE
+  drawq_start(); // from here on the other core draws (drawq.h)
+#endif
+}
+
+#define REFRESH_HZ 30 // screen updates per second while input is streaming
+
+#define PURPLE_ON_BLACK "\e[35;40m"
+#define GREEN_ON_BLACK "\e[32;40m"
+
+//#define VT100_BENCHMARK // compare vt100_putc() and vt100_write() at startup
+//#define SHOW_LATENCY // 99th percentile byte to pixel latency on the status row
+//#define SPLIT_SCREEN // a pane per port: Serial1 (UART) above, Serial (USB) below
+
+#ifdef SPLIT_SCREEN
+#if VT100_INSTANCES < 3
+#error "SPLIT_SCREEN needs VT100_INSTANCES 3 (vt100.h)"
+#endif
+// first row and rows of each pane, clear of the header, the label row
+// between them and the status rows
+#define UART_PANE_ROW 3
+#define UART_PANE_ROWS 17
+#define USB_PANE_ROW 21
+#define USB_PANE_ROWS 16
+#endif
+
+// box left of the LEDs, filled while the terminal is behind on the input
+// and only keeps its screen in memory (jump scroll, see vt100_setBacklog())
+void showSkipping(uint8_t on){
+  if(on) display_fillRect(170,6,10,10,DISPLAY_BLUE);
+  else display_drawRect(170,6,10,10,DISPLAY_BLUE,DISPLAY_BLACK);
+  // nothing else goes out until the backlog drains
+  display_flush();
+  skipShadow=on;
+}
+
+// either port's terminal is jump scrolling
+uint8_t anySkipping(){
+  return vt100_skipping(uartTerm) || vt100_skipping(usbTerm);
+}
+
+// input taken in without repainting, both ports
+uint32_t skippedBytes(){
+  uint32_t n = vt100_skipped(uartTerm);
+  if(usbTerm != uartTerm) n += vt100_skipped(usbTerm);
+  return n;
+}
+
+#ifdef VT100_BENCHMARK
+#define BENCH_LINES 200
+static const char benchLine[] PROGMEM =
+  "[  12.345678] usb 1-1: new high-speed USB device number 2 using ehci-pci\r\n";
+
+// pushes the same log flood through the byte and the bulk entry point and
+// reports bytes/second for each over the USB serial port
+void benchmark(struct vt100 *t){
+  char line[sizeof(benchLine)];
+  strcpy_P(line, benchLine);
+  size_t len = strlen(line);
+  uint32_t bytes = (uint32_t)len * BENCH_LINES;
+
+  uint32_t start = micros();
+  for(int i = 0; i < BENCH_LINES; i++)
+    for(size_t j = 0; j < len; j++) vt100_putc(t, line[j]);
+  uint32_t putcTime = micros() - start;
+
+  start = micros();
+  for(int i = 0; i < BENCH_LINES; i++)
+    vt100_write(t, (const uint8_t *)line, len);
+  uint32_t writeTime = micros() - start;
+
+  char report[64];
+  sprintf(report, "vt100_putc: %lu bytes/s\r\n", bytes * 1000UL / (putcTime / 1000UL + 1));
+  Serial.print(report);
+  sprintf(report, "vt100_write: %lu bytes/s\r\n", bytes * 1000UL / (writeTime / 1000UL + 1));
+  Serial.print(report);
+#if !defined(VT100_RA8876)
+  uint32_t hits, misses;
+  ili9340_glyphStats(&hits, &misses);
+  sprintf(report, "glyph cache: %d x %d bytes, %lu%% hits\r\n", ILI9340_GLYPH_CACHE, 96,
+    hits * 100UL / (hits + misses + 1));
+  Serial.print(report);
+  sprintf(report, "window cache saved: text %lu fill %lu line %lu bytes\r\n",
+    ili9340_bytesSaved(ILI9340_OP_TEXT), ili9340_bytesSaved(ILI9340_OP_FILL),
+    ili9340_bytesSaved(ILI9340_OP_LINE));
+  Serial.print(report);
+#endif
+#if VT100_DLIST
+  uint32_t merged, dropped;
+  dlist_stats(&merged, &dropped);
+  sprintf(report, "display list: %lu runs merged, %lu ops dropped\r\n", merged, dropped);
+  Serial.print(report);
+#endif
+}
+#endif
+
+void loop() {
+  term = vt100_init(0);
+#ifdef SPLIT_SCREEN
+  uartTerm = vt100_init(1);
+  usbTerm = vt100_init(2);
+  // the status terminal never scrolls, so it leaves the panes alone.
+  // vt100_init() takes the scroll window, the viewports come after.
+  vt100_setViewport(term, 0, 0, VT100_WIDTH, VT100_HEIGHT, 0);
+  vt100_setViewport(uartTerm, 0, UART_PANE_ROW * VT100_CHAR_HEIGHT, VT100_WIDTH, UART_PANE_ROWS, 1);
+  vt100_setViewport(usbTerm, 0, USB_PANE_ROW * VT100_CHAR_HEIGHT, VT100_WIDTH, USB_PANE_ROWS, 0);
+  vt100_setRefreshRate(uartTerm, REFRESH_HZ);
+  vt100_setRefreshRate(usbTerm, REFRESH_HZ);
+#else
+  uartTerm = usbTerm = term;
+#endif
+  vt100_setRefreshRate(term, REFRESH_HZ);
+  interrupts();
+ 
+  // reset terminal and clear screen..
+  vt100_puts(usbTerm, "\e[c");   // terminal ok
+#ifdef SPLIT_SCREEN
+  vt100_puts(uartTerm, "\e[c");
+#endif
+  vt100_puts(term, "\e[2J");  // erase entire screen
+  vt100_puts(term, "\e[?6l"); // absolute origin
+  // print some fixed purple text top and bottom
+  vt100_puts(term, PURPLE_ON_BLACK);   
+  vt100_puts(term, "\e[2;1HSerial HC2016 Terminal 1.0"); 
+  vt100_puts(term, "\e[39;1HBaud: 115200");
+  vt100_puts(term, "\e[39;15HChars:");
+  vt100_puts(term, "\e[39;31HSkip:");
+  vt100_puts(term, "\e[40;1HRx max:");
+  vt100_puts(term, "\e[40;15HLost:");
+#ifdef SHOW_LATENCY
+  vt100_puts(term, "\e[40;28Hp99:");
+#endif
+#ifdef SPLIT_SCREEN
+  vt100_puts(term, "\e[21;1H^ Serial1 (UART)");
+  vt100_puts(term, "\e[21;27Hv Serial (USB)");
+#endif
+  // 4 LEDS in the top corner initially set to OFF
+  display_drawRect(186,6,10,10,DISPLAY_RED,DISPLAY_BLACK);
+  display_drawRect(200,6,10,10,DISPLAY_RED,DISPLAY_BLACK);
+  display_drawRect(214,6,10,10,DISPLAY_RED,DISPLAY_BLACK);
+  display_drawRect(228,6,10,10,DISPLAY_RED,DISPLAY_BLACK);
+  showSkipping(0);
+  // delimit fixed areas
+  display_drawFastHLine(0,20, 240, DISPLAY_BLUE);
+  display_drawFastHLine(0,300, 240, DISPLAY_RED);
+#ifdef SPLIT_SCREEN
+  vt100_puts(term, "\e[H\e[0q"); // LEDs off, away from the status rows
+  vt100_puts(uartTerm, GREEN_ON_BLACK);
+  vt100_puts(usbTerm, GREEN_ON_BLACK);
+#else
+  vt100_puts(term, "\e[4;37r"); // set the scrolling region
+  vt100_puts(term, GREEN_ON_BLACK);
+  vt100_puts(term, "\e[37;1H"); // Set up at line 37, char position 1
+  vt100_puts(term, "\e[0q"); // All top corner LEDs off
+#endif
+
+  if ((EEPROM.read(BAUD_STORE)^EEPROM.read(BAUD_STORE+1))==0xff)
+  {
+    char bStr[12];
+    sprintf(bStr,"\e[%dX",EEPROM.read(BAUD_STORE));
+    vt100_puts(term, bStr);
+  }
+  else vt100_puts(term, "\e[6X"); // baud rate 6 - i.e. 115200
+  if ((EEPROM.read(FLOW_STORE)^EEPROM.read(FLOW_STORE+1))==0xff)
+  {
+    char fStr[12];
+    sprintf(fStr,"\e[%dX",EEPROM.read(FLOW_STORE));
+    vt100_puts(term, fStr);
+  }
+
+#ifdef VT100_BENCHMARK
+  benchmark(uartTerm);
+#endif
+ 
+  while(1){
+    // send replies (cursor reports etc) as far as the port takes them
+    // without waiting
+    const uint8_t *reply;
+    size_t replyCount = vt100_txChunk(usbTerm, &reply);
+    if(replyCount)
+          {
+          int room = Serial.availableForWrite();
+          if((int)replyCount > room) replyCount = room;
+          Serial.write(reply, replyCount);
+          vt100_txConsume(usbTerm, replyCount);
+          }
+#ifdef SPLIT_SCREEN
+    // the UART pane answers its own host
+    replyCount = vt100_txChunk(uartTerm, &reply);
+    if(replyCount) vt100_txConsume(uartTerm, uart_txWrite(reply, replyCount));
+#endif
+    // the host UART is already buffered by its receive interrupt - hand
+    // over everything that is waiting so runs of printable characters
+    // can be drawn together by vt100_write()
+    uart_poll();
+#if VT100_PIPELINE
+    // the render core is behind - leave the input in the receive ring,
+    // whose flow control holds the host off, until it catches up
+    if(drawq_used() > DRAWQ_HIGH_WATER) continue;
+#endif
+    const uint8_t *rx;
+    uint8_t data[64];
+    size_t count = uart_rxChunk(&rx);
+#ifdef SPLIT_SCREEN
+    // the ports take turns, each with as much as the USB one reads at a
+    // time, so a flood on one can't hold the other up
+    if(count > sizeof(data)) count = sizeof(data);
+#endif
+    if(count)
+          {
+          // time one byte at a time from the ring to the panel
+          uint32_t arrived;
+          if(uart_rxStamp(count, &arrived)) vt100_stamp(uartTerm, arrived);
+          // stop repainting while the ring fills faster than we draw
+          vt100_setBacklog(uartTerm, uart_rxUsed() - count);
+          charCounter += count;
+          vt100_write(uartTerm, rx, count);
+          uart_rxConsume(count);
+          if(anySkipping()!=skipShadow) showSkipping(anySkipping());
+#ifndef SPLIT_SCREEN
+          continue;
+#endif
+          }
+#ifdef SPLIT_SCREEN
+    // the UART pane's input went idle
+    else vt100_flush(uartTerm);
+    uint8_t uartIdle = !count;
+    count = 0;
+#endif
+    int c;
+    while(count < sizeof(data) && (c = Serial.read()) != -1) data[count++] = c;
+    if(count) vt100_setBacklog(usbTerm, Serial.available());
+    if(!count) 
+          {   
+          // input went idle - put the last partial frame on screen
+          vt100_flush(usbTerm);
+#ifdef SPLIT_SCREEN
+          // the status rows wait until both ports are quiet
+          if(!uartIdle) continue;
+#endif
+          if(skipShadow) showSkipping(0);
+          //if nothing coming in serial - check for baud rate message
+          if (new_br[0]) 
+              { 
+                vt100_puts(term, "\e7\e[39;7H"); // save cursor and attribs
+                vt100_puts(term, PURPLE_ON_BLACK);
+                vt100_puts(term, new_br); 
+                vt100_puts(term, "\e8"); // restore cursor and attribs
+                new_br[0]=0; 
+               } 
+          //or character count update
+          if ((charCounter!=charShadow) || (charStart))
+            {
+              charShadow=charCounter; charStart=0;
+              vt100_puts(term, "\e7");  //save cursor and color
+              vt100_puts(term, PURPLE_ON_BLACK);
+              char numbers[12]; sprintf(numbers,"%ld",charCounter); 
+              vt100_puts(term, "\e[39;22H"); vt100_puts(term, numbers);          
+              vt100_puts(term, "\e8");  //restore cursor and attribs                
+            }
+          //or receive ring statistics
+          if ((uart_rxHighWater()!=highShadow) || (uart_rxOverruns()!=overrunShadow))
+            {
+              highShadow=uart_rxHighWater(); overrunShadow=uart_rxOverruns();
+              vt100_puts(term, "\e7");  //save cursor and color
+              vt100_puts(term, PURPLE_ON_BLACK);
+              char numbers[12]; 
+              sprintf(numbers,"%u",highShadow); vt100_puts(term, "\e[40;9H"); vt100_puts(term, numbers);
+              sprintf(numbers,"%lu",overrunShadow); vt100_puts(term, "\e[40;21H"); vt100_puts(term, numbers);
+              vt100_puts(term, "\e8");  //restore cursor and attribs                
+            }
+          //or bytes taken in without repainting, in k
+          if (skippedBytes()!=skippedShadow)
+            {
+              skippedShadow=skippedBytes();
+              vt100_puts(term, "\e7");  //save cursor and color
+              vt100_puts(term, PURPLE_ON_BLACK);
+              uint32_t k=(skippedShadow+1023)/1024;
+              char numbers[12];
+              if(k<1000) sprintf(numbers,"%luk ",k); else sprintf(numbers,"%luM ",(k+1023)/1024);
+              vt100_puts(term, "\e[39;36H"); vt100_puts(term, numbers);
+              vt100_puts(term, "\e8");  //restore cursor and attribs
+            }
+#ifdef SHOW_LATENCY
+          //or latency, in whole ms
+          if (latency_percentile(99)!=latencyShadow)
+            {
+              latencyShadow=latency_percentile(99);
+              vt100_puts(term, "\e7");  //save cursor and color
+              vt100_puts(term, PURPLE_ON_BLACK);
+              char numbers[12]; sprintf(numbers,"%lums ",(latencyShadow+999)/1000);
+              vt100_puts(term, "\e[40;33H"); vt100_puts(term, numbers);
+              vt100_puts(term, "\e8");  //restore cursor and attribs
+            }
+#endif
+            continue;
+          }
+    charCounter += count;
+    vt100_write(usbTerm, data, count);  
+    if(anySkipping()!=skipShadow) showSkipping(anySkipping());
+  }
+}
\ No newline at end of file